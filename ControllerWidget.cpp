@@ -30,18 +30,58 @@
 
 #include <QGroupBox>
 #include <QRadioButton>
+#include <QCheckBox>
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QDockWidget>
 #include <QTextStream>
+#include <QApplication>
+#include <QSpinBox>
+#include <QRunnable>
 
 #include <iostream>
 
 #include "ControllerWidget.h"
+#include "Topology.h"
+#include "View.h"
 
 /************************************************************************/
+/* Builds the edge and face tables away from the GUI thread and hands
+ * the counts back to the widget, which drops them if the mesh changed */
+class TopologyCounter : public QRunnable
+{
+    MainControllerWidget                *_widget;
+    std::shared_ptr<NetgenNeutralMesh>  _nnm;
+    uint                                _generation;
+    
+public:
+    TopologyCounter(MainControllerWidget *widget,
+                    std::shared_ptr<NetgenNeutralMesh> nnm, uint generation)
+        : _widget(widget), _nnm(nnm), _generation(generation)
+    {}
+    
+    void
+    run(void)
+    {
+        MeshTopology& topo = _nnm->topology();
+        double megabytes = topo.memoryUsage()/double(1 << 20);
+        QString str;
+        
+        QTextStream(&str) << "Edges: " << topo.edges()->size() << "\n"
+                          << "Faces: " << topo.faces()->size() << "\n"
+                          << "Non-manifold faces: " << topo.nonManifoldFaces() << "\n"
+                          << "Topology memory: "
+                          << QString::number(megabytes, 'f', 1) << " MB";
+        
+        QMetaObject::invokeMethod(_widget, "topologyCounted",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(uint, _generation),
+                                  Q_ARG(QString, str));
+    }
+};
+
 MainControllerWidget::MainControllerWidget(QWidget *parent)
-    : QWidget(parent)
+    : QWidget(parent), _topologyGeneration(0)
 {
     _mesh_numpoints.setText("Mesh not yet loaded");
     
@@ -55,6 +95,8 @@ MainControllerWidget::MainControllerWidget(QWidget *parent)
     setLayout(layout);
     
     _nnm = nullptr;
+    
+    _topologyPool.setMaxThreadCount(1);
 }
 
 QWidget *
@@ -67,8 +109,16 @@ MainControllerWidget::makeMeshInfoGroup(void)
     vbox->addWidget(&_mesh_numpoints);
     vbox->addWidget(&_mesh_numtets);
     vbox->addWidget(&_mesh_numtris);
+    vbox->addWidget(&_mesh_topology);
+    
+    _topology_button = new QPushButton(tr("Compute topology"));
+    _topology_button->setEnabled(false);
+    vbox->addWidget(_topology_button);
     vbox->addStretch(1);
     
+    connect(_topology_button, SIGNAL(clicked(bool)),
+            this, SLOT(topologyButtonClicked(bool)));
+    
     groupbox->setLayout(vbox);
     return groupbox;
 }
@@ -79,11 +129,30 @@ MainControllerWidget::makeWhatToDrawBtnGroup(void)
     QGroupBox *whatToDrawBtnGroup = new QGroupBox(tr("Elems to draw"));
     QRadioButton *radio_tets = new QRadioButton(tr("Tetrahedrons"));
     QRadioButton *radio_tris = new QRadioButton(tr("Triangles"));
+    QRadioButton *radio_shells = new QRadioButton(tr("Domain surfaces"));
     radio_tets->setChecked(true);
     
+    QCheckBox *wireframe = new QCheckBox(tr("Wireframe"));
+    wireframe->setChecked(true);
+    
+    _quantized = new QCheckBox(tr("Quantized vertices"));
+    
+    QSpinBox *frameBudget = new QSpinBox();
+    frameBudget->setRange(5, 500);
+    frameBudget->setSuffix(" ms");
+    frameBudget->setValue(FRAME_BUDGET_MS);
+    
+    QHBoxLayout *budgetBox = new QHBoxLayout();
+    budgetBox->addWidget(new QLabel(tr("Frame budget")));
+    budgetBox->addWidget(frameBudget);
+    
     QVBoxLayout *vbox = new QVBoxLayout();
     vbox->addWidget(radio_tets);
     vbox->addWidget(radio_tris);
+    vbox->addWidget(radio_shells);
+    vbox->addWidget(wireframe);
+    vbox->addWidget(_quantized);
+    vbox->addLayout(budgetBox);
     vbox->addStretch(1);
     
     whatToDrawBtnGroup->setLayout(vbox);
@@ -94,6 +163,18 @@ MainControllerWidget::makeWhatToDrawBtnGroup(void)
     QObject::connect(radio_tets, SIGNAL(clicked(bool)),
                      this, SIGNAL(drawTetrahedronsRequested()));
     
+    QObject::connect(radio_shells, SIGNAL(clicked(bool)),
+                     this, SIGNAL(drawShellsRequested()));
+    
+    QObject::connect(wireframe, SIGNAL(toggled(bool)),
+                     this, SIGNAL(wireframeToggled(bool)));
+    
+    QObject::connect(_quantized, SIGNAL(toggled(bool)),
+                     this, SIGNAL(quantizedToggled(bool)));
+    
+    QObject::connect(frameBudget, SIGNAL(valueChanged(int)),
+                     this, SIGNAL(frameBudgetChanged(int)));
+    
     return whatToDrawBtnGroup;
 }
 
@@ -203,18 +284,38 @@ MainControllerWidget::updateMeshInfo(void)
     _mesh_numpoints.setText(str);
     
     str.clear();
-    num = 0;
-    for (auto& b : _nnm->boundaries())
-        num += b.second.size();
+    num = _nnm->boundaries().elementCount();
     QTextStream(&str) << "Triangles: " << num;
     _mesh_numtris.setText(str);
     
     str.clear();
-    num = 0;
-    for (auto& d : _nnm->domains())
-        num += d.second.size();
+    num = _nnm->domains().elementCount();
     QTextStream(&str) << "Tetrahedrons: " << num;
     _mesh_numtets.setText(str);
+    
+    _mesh_topology.clear();
+    _topology_button->setEnabled(true);
+}
+
+/* Edges and faces are only counted on request, building the tables
+ * takes a while on big meshes */
+void
+MainControllerWidget::topologyButtonClicked(bool)
+{
+    if (!_nnm)
+        return;
+    
+    _mesh_topology.setText("Computing topology...");
+    _topology_button->setEnabled(false);
+    
+    _topologyPool.start( new TopologyCounter(this, _nnm, _topologyGeneration) );
+}
+
+void
+MainControllerWidget::topologyCounted(uint generation, QString str)
+{
+    if (generation == _topologyGeneration)
+        _mesh_topology.setText(str);
 }
 
 void
@@ -235,10 +336,10 @@ MainControllerWidget::updateLists(void)
     for ( auto& b : _nnm->boundaries() )
     {
         QString entry_str;
-        entry_str.sprintf("Boundary %lu", b.first);
+        entry_str.sprintf("Boundary %lu", b.id());
         
         QListWidgetItem *item = new QListWidgetItem(entry_str);
-        item->setData(Qt::UserRole, QVariant( uint(b.first) ));
+        item->setData(Qt::UserRole, QVariant( uint(b.id()) ));
         
         _bnd_listwidget->addItem(item);
     }
@@ -248,19 +349,29 @@ MainControllerWidget::updateLists(void)
     for ( auto& d : _nnm->domains() )
     {
         QString entry_str;
-        entry_str.sprintf("Domain %lu", d.first);
+        entry_str.sprintf("Domain %lu", d.id());
         
         QListWidgetItem *item = new QListWidgetItem(entry_str);
-        item->setData(Qt::UserRole, QVariant( uint(d.first) ));
+        item->setData(Qt::UserRole, QVariant( uint(d.id()) ));
         
         _dom_listwidget->addItem(item);
     }
 }
 
+/* Follows the renderer, which can turn quantization down */
+void
+MainControllerWidget::setQuantized(bool quantized)
+{
+    _quantized->blockSignals(true);
+    _quantized->setChecked(quantized);
+    _quantized->blockSignals(false);
+}
+
 void
 MainControllerWidget::setMesh(std::shared_ptr<NetgenNeutralMesh> nnm)
 {
     _nnm = nnm;
+    _topologyGeneration++;
     updateMeshInfo();
     updateLists();
 }
@@ -303,6 +414,8 @@ BoundaryControllerWidget::BoundaryControllerWidget(QWidget *parent)
     setLayout(layout);
     
     _nnm = nullptr;
+    
+    _topologyPool.setMaxThreadCount(1);
 }
 
 void
@@ -414,6 +527,8 @@ DomainControllerWidget::DomainControllerWidget(QWidget *parent)
             this, SLOT(domainColorChanged(const QColor&)));
     
     _nnm = nullptr;
+    
+    _topologyPool.setMaxThreadCount(1);
 }
 
 void
@@ -600,10 +715,10 @@ BoundaryGroupControllerWidget::boundaryGroupSelected(QListWidgetItem *item)
     
     for (auto& b : _nnm->boundaries())
     {
-        if (b.second.group() == group)
+        if (b.group() == group)
         {
-            QTextStream(&str) << b.first << " ";
-            b.second.setHighlighted(true);
+            QTextStream(&str) << b.id() << " ";
+            b.setHighlighted(true);
         }
     }
     emit meshUpdated();
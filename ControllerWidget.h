@@ -38,6 +38,8 @@
 #include <QPushButton>
 #include <QLineEdit>
 #include <QComboBox>
+#include <QCheckBox>
+#include <QThreadPool>
 #include "Mesh.h"
 
 /************************************************************************/
@@ -49,6 +51,9 @@ class MainControllerWidget : public QWidget
     QLabel          _mesh_numpoints;
     QLabel          _mesh_numtets;
     QLabel          _mesh_numtris;
+    QLabel          _mesh_topology;
+    QPushButton     *_topology_button;
+    QCheckBox       *_quantized;
     
     QListWidget     *_bnd_listwidget;
     QListWidget     *_dom_listwidget;
@@ -58,6 +63,9 @@ class MainControllerWidget : public QWidget
     
     std::shared_ptr<NetgenNeutralMesh> _nnm;
     
+    uint            _topologyGeneration;
+    QThreadPool     _topologyPool;
+    
 private:
     QWidget *   makeMeshInfoGroup(void);
     QWidget *   makeWhatToDrawBtnGroup(void);
@@ -70,10 +78,16 @@ private:
 private slots:
     void        bndListElemSelected(QListWidgetItem *item, QListWidgetItem *prev);
     void        domListElemSelected(QListWidgetItem *item, QListWidgetItem *prev);
+    void        topologyButtonClicked(bool);
+    void        topologyCounted(uint, QString);
     
 signals:
     void        drawTetrahedronsRequested();
     void        drawTrianglesRequested();
+    void        drawShellsRequested();
+    void        wireframeToggled(bool);
+    void        quantizedToggled(bool);
+    void        frameBudgetChanged(int);
     void        meshUpdated();
     void        boundarySelected(int);
     void        domainSelected(int);
@@ -83,6 +97,7 @@ public:
     
 public slots:
     void    setMesh(std::shared_ptr<NetgenNeutralMesh>);
+    void    setQuantized(bool);
     
 };
 
@@ -0,0 +1,308 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cstring>
+
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "Decompressor.h"
+
+/*****************************************************************************/
+DecompressStream::DecompressStream()
+    : _src(nullptr), _srclen(0), _format(NONE),
+      _done(false), _abort(false), _error(false), _in_done(0)
+{}
+
+DecompressStream::~DecompressStream()
+{
+    /* The parser may stop early (error, cancel): release the worker */
+    {
+        std::lock_guard<std::mutex> lk(_lock);
+        _abort = true;
+    }
+    _cv.notify_all();
+    
+    if ( _worker.joinable() )
+        _worker.join();
+}
+
+DecompressStream::Format
+DecompressStream::detect(const char *data, size_t len)
+{
+    const unsigned char *d = (const unsigned char *)data;
+    
+    if (len >= 2 && d[0] == 0x1f && d[1] == 0x8b)
+        return GZIP;
+    
+    if (len >= 4 && d[0] == 0x28 && d[1] == 0xb5 && d[2] == 0x2f && d[3] == 0xfd)
+        return ZSTD;
+    
+    return NONE;
+}
+
+bool
+DecompressStream::start(Format format, const char *src, size_t len)
+{
+#ifndef HAVE_ZSTD
+    if (format == ZSTD)
+    {
+        std::cout << "This build has no zstd support" << std::endl;
+        return false;
+    }
+#endif
+    
+    if (format == NONE || _worker.joinable())
+        return false;
+    
+    _format = format;
+    _src = src;
+    _srclen = len;
+    
+    _worker = std::thread(&DecompressStream::run, this);
+    return true;
+}
+
+/*****************************************************************************/
+/* Producer side */
+std::vector<char>
+DecompressStream::get_free_block(void)
+{
+    std::lock_guard<std::mutex> lk(_lock);
+    
+    if ( _free.empty() )
+        return std::vector<char>(BLOCK_SIZE);
+    
+    std::vector<char> blk;
+    blk.swap(_free.back());
+    _free.pop_back();
+    blk.resize(BLOCK_SIZE);
+    return blk;
+}
+
+/* Queue a block, waiting while the consumer is MAX_QUEUED blocks
+ * behind. Returns false if the consumer went away. */
+bool
+DecompressStream::put_full_block(std::vector<char>& blk)
+{
+    std::unique_lock<std::mutex> lk(_lock);
+    
+    _cv.wait(lk, [this]() { return _abort || _full.size() < MAX_QUEUED; });
+    if (_abort)
+        return false;
+    
+    _full.push_back( std::move(blk) );
+    _cv.notify_all();
+    return true;
+}
+
+void
+DecompressStream::run(void)
+{
+    bool ok = (_format == GZIP) ? inflate_gzip() : inflate_zstd();
+    
+    std::lock_guard<std::mutex> lk(_lock);
+    if (!ok && !_abort)
+        _error = true;
+    _done = true;
+    _cv.notify_all();
+}
+
+bool
+DecompressStream::inflate_gzip(void)
+{
+    z_stream zs;
+    
+    memset(&zs, 0, sizeof(zs));
+    
+    /* 15 + 32: any window size, gzip or zlib header autodetected */
+    if ( inflateInit2(&zs, 15 + 32) != Z_OK )
+        return false;
+    
+    zs.next_in = (Bytef *)_src;
+    zs.avail_in = 0;
+    
+    size_t  in_left = _srclen;
+    bool    ok = true;
+    int     ret = Z_OK;
+    
+    while (ok)
+    {
+        std::vector<char> blk = get_free_block();
+        
+        zs.next_out = (Bytef *)blk.data();
+        zs.avail_out = blk.size();
+        
+        while (zs.avail_out > 0)
+        {
+            /* avail_in is 32 bits, feed huge inputs in slices */
+            if (zs.avail_in == 0 && in_left > 0)
+            {
+                zs.avail_in = (in_left > (1u << 30)) ? (1u << 30) : in_left;
+                in_left -= zs.avail_in;
+            }
+            
+            ret = inflate(&zs, Z_NO_FLUSH);
+            _in_done = zs.next_in - (const Bytef *)_src;
+            
+            if (ret == Z_STREAM_END)
+            {
+                /* Concatenated gzip members (pigz, cat a.gz b.gz) */
+                if (zs.avail_in == 0 && in_left == 0)
+                    break;
+                
+                if ( inflateReset(&zs) != Z_OK )
+                {
+                    ok = false;
+                    break;
+                }
+                continue;
+            }
+            
+            if (ret != Z_OK)
+            {
+                /* Z_BUF_ERROR with input left means a truncated file */
+                ok = false;
+                break;
+            }
+        }
+        
+        blk.resize(blk.size() - zs.avail_out);
+        
+        if ( !blk.empty() && !put_full_block(blk) )
+            ok = false;
+        
+        if (ret == Z_STREAM_END && zs.avail_in == 0 && in_left == 0)
+            break;
+    }
+    
+    inflateEnd(&zs);
+    return ok;
+}
+
+bool
+DecompressStream::inflate_zstd(void)
+{
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zds = ZSTD_createDStream();
+    
+    if (!zds)
+        return false;
+    
+    ZSTD_initDStream(zds);
+    
+    ZSTD_inBuffer in = { _src, _srclen, 0 };
+    bool ok = true;
+    size_t ret = 0;
+    
+    while (ok && (in.pos < in.size || ret != 0))
+    {
+        std::vector<char> blk = get_free_block();
+        ZSTD_outBuffer out = { blk.data(), blk.size(), 0 };
+        
+        while (out.pos < out.size && (in.pos < in.size || ret != 0))
+        {
+            ret = ZSTD_decompressStream(zds, &out, &in);
+            _in_done = in.pos;
+            
+            if ( ZSTD_isError(ret) )
+            {
+                ok = false;
+                break;
+            }
+            
+            /* No progress possible: the input is truncated */
+            if (in.pos == in.size && ret != 0 && out.pos < out.size)
+            {
+                ok = false;
+                break;
+            }
+        }
+        
+        blk.resize(out.pos);
+        
+        if ( !blk.empty() && !put_full_block(blk) )
+            ok = false;
+    }
+    
+    ZSTD_freeDStream(zds);
+    return ok;
+#else
+    return false;
+#endif
+}
+
+/*****************************************************************************/
+/* Consumer side */
+bool
+DecompressStream::refill(const char *& cur, const char *& end)
+{
+    std::vector<char> blk;
+    
+    {
+        std::unique_lock<std::mutex> lk(_lock);
+        
+        _cv.wait(lk, [this]() { return _done || !_full.empty(); });
+        if ( _full.empty() )
+            return false;
+        
+        blk = std::move(_full.front());
+        _full.pop_front();
+        _cv.notify_all();
+    }
+    
+    /* Carry the unread tail over, then append the new block. The tail
+     * usually points into _window itself. */
+    size_t tail = (cur < end) ? end - cur : 0;
+    size_t need = tail + blk.size();
+    
+    if (_window.size() < need)
+    {
+        std::vector<char> w(need);
+        if (tail)
+            memcpy(w.data(), cur, tail);
+        _window.swap(w);
+    }
+    else if (tail)
+        memmove(_window.data(), cur, tail);
+    
+    memcpy(_window.data() + tail, blk.data(), blk.size());
+    
+    cur = _window.data();
+    end = _window.data() + need;
+    
+    std::lock_guard<std::mutex> lk(_lock);
+    _free.push_back( std::move(blk) );
+    
+    return true;
+}
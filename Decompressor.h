@@ -0,0 +1,101 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "TextScanner.h"
+
+/*******************************************************************/
+/* Streaming decompression of a gzip (or zstd, when built with
+ * HAVE_ZSTD) file held in memory. A worker thread inflates the input
+ * into fixed-size blocks and queues them; the consumer pulls them
+ * through the ByteStream interface, so decompression and parsing run
+ * at the same time with a bounded amount of memory.
+ */
+class DecompressStream : public ByteStream
+{
+public:
+    enum Format {
+        NONE,
+        GZIP,
+        ZSTD
+    };
+    
+private:
+    static const size_t BLOCK_SIZE = 1 << 20;
+    static const size_t MAX_QUEUED = 4;
+    
+    const char                      *_src;
+    size_t                          _srclen;
+    Format                          _format;
+    
+    std::thread                     _worker;
+    std::mutex                      _lock;
+    std::condition_variable         _cv;
+    std::deque<std::vector<char>>   _full;
+    std::vector<std::vector<char>>  _free;
+    bool                            _done, _abort;
+    std::atomic<bool>               _error;
+    std::atomic<size_t>             _in_done;
+    
+    std::vector<char>               _window;
+    
+    DecompressStream(const DecompressStream&) = delete;
+    DecompressStream& operator=(const DecompressStream&) = delete;
+    
+    void            run(void);
+    bool            inflate_gzip(void);
+    bool            inflate_zstd(void);
+    
+    std::vector<char>   get_free_block(void);
+    bool                put_full_block(std::vector<char>&);
+    
+public:
+    DecompressStream();
+    ~DecompressStream();
+    
+    static Format   detect(const char *, size_t);
+    
+    bool            start(Format, const char *, size_t);
+    
+    virtual bool    refill(const char *&, const char *&);
+    virtual bool    failed(void) const { return _error; }
+    
+    /* Compressed bytes consumed so far, for progress reporting */
+    size_t          consumed(void) const { return _in_done; }
+};
+
@@ -0,0 +1,176 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Edges.h"
+
+/* Keys handled by a worker thread at a time */
+#define CHUNK_KEYS      65536
+
+/*****************************************************************************/
+/* Least significant digit first, 8 bits at a time. Every block of the
+ * input gets its own histogram so that the blocks are scattered in
+ * parallel; digits that are the same for all the keys, like the high
+ * bits of point indices, are skipped.
+ */
+void
+sort_unique_keys(std::vector<uint64_t>& keys)
+{
+    size_t n = keys.size();
+    
+    if (n < 2)
+        return;
+    
+    size_t nblocks = std::max(size_t(1), std::min(4*worker_count(), n/CHUNK_KEYS));
+    size_t bsize = (n + nblocks - 1)/nblocks;
+    
+    std::vector<uint64_t> tmp(n);
+    std::vector<size_t> hist(nblocks*256);
+    uint64_t *src = keys.data();
+    uint64_t *dst = tmp.data();
+    
+    for (size_t shift = 0; shift < 64; shift += 8)
+    {
+        std::fill(hist.begin(), hist.end(), 0);
+        
+        parallel_for(nblocks, [&](size_t b) {
+            size_t *h = &hist[b*256];
+            size_t end = std::min(n, (b+1)*bsize);
+            for (size_t i = b*bsize; i < end; i++)
+                h[(src[i] >> shift) & 0xff]++;
+        });
+        
+        /* Histograms to scatter positions, digit major */
+        size_t pos = 0;
+        bool trivial = false;
+        for (size_t d = 0; d < 256; d++)
+        {
+            size_t start = pos;
+            for (size_t b = 0; b < nblocks; b++)
+            {
+                size_t count = hist[b*256 + d];
+                hist[b*256 + d] = pos;
+                pos += count;
+            }
+            
+            if (pos - start == n)
+                trivial = true;
+        }
+        
+        if (trivial)
+            continue;
+        
+        parallel_for(nblocks, [&](size_t b) {
+            size_t *h = &hist[b*256];
+            size_t end = std::min(n, (b+1)*bsize);
+            for (size_t i = b*bsize; i < end; i++)
+                dst[ h[(src[i] >> shift) & 0xff]++ ] = src[i];
+        });
+        
+        std::swap(src, dst);
+    }
+    
+    if (src != keys.data())
+        keys.swap(tmp);
+    
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+}
+
+/*****************************************************************************/
+/* Lengths are computed into a buffer and reduced with plain loops the
+ * compiler vectorizes. Partial results are combined in chunk order, so
+ * the result does not depend on the number of threads.
+ */
+EdgeLengths
+edge_lengths(const PointStore& points, const std::vector<uint64_t>& keys)
+{
+    EdgeLengths ret = { 0, 0, 0 };
+    size_t n = keys.size();
+    
+    if (n == 0)
+        return ret;
+    
+    size_t chunks = (n + CHUNK_KEYS - 1)/CHUNK_KEYS;
+    std::vector<EdgeLengths> partial(chunks);
+    
+    const double *x = points.x();
+    const double *y = points.y();
+    const double *z = points.z();
+    
+    parallel_for(chunks, [&](size_t c) {
+        size_t first = c*CHUNK_KEYS;
+        size_t count = std::min(n - first, size_t(CHUNK_KEYS));
+        std::vector<double> len(count);
+        
+        for (size_t i = 0; i < count; i++)
+        {
+            uint32_t a = edge_first(keys[first+i]);
+            uint32_t b = edge_second(keys[first+i]);
+            double dx = x[a] - x[b];
+            double dy = y[a] - y[b];
+            double dz = z[a] - z[b];
+            len[i] = sqrt(dx*dx + dy*dy + dz*dz);
+        }
+        
+        /* Four independent sums, to let the additions run side by side */
+        double lo = len[0], hi = len[0], sum[4] = { 0, 0, 0, 0 };
+        size_t i;
+        for (i = 0; i < count; i++)
+        {
+            lo = (len[i] < lo) ? len[i] : lo;
+            hi = (len[i] > hi) ? len[i] : hi;
+        }
+        
+        for (i = 0; i+4 <= count; i += 4)
+        {
+            sum[0] += len[i+0];
+            sum[1] += len[i+1];
+            sum[2] += len[i+2];
+            sum[3] += len[i+3];
+        }
+        for (; i < count; i++)
+            sum[0] += len[i];
+        
+        partial[c].min = lo;
+        partial[c].max = hi;
+        partial[c].avg = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+    });
+    
+    ret = partial[0];
+    for (size_t c = 1; c < chunks; c++)
+    {
+        ret.min = std::min(ret.min, partial[c].min);
+        ret.max = std::max(ret.max, partial[c].max);
+        ret.avg += partial[c].avg;
+    }
+    
+    ret.avg /= n;
+    
+    return ret;
+}
@@ -0,0 +1,107 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "PointStore.h"
+#include "Parallel.h"
+
+/*******************************************************************/
+/* Edges are packed in 64-bit keys, the smaller point index in the
+ * upper half: sorting the keys sorts the edges lexicographically.
+ */
+inline uint64_t
+edge_key(uint32_t a, uint32_t b)
+{
+    return (uint64_t(a) << 32) | b;
+}
+
+inline uint32_t edge_first(uint64_t key) { return key >> 32; }
+inline uint32_t edge_second(uint64_t key) { return uint32_t(key); }
+
+/* Sorts the keys with a parallel radix sort and removes duplicates */
+void    sort_unique_keys(std::vector<uint64_t>&);
+
+struct EdgeLengths
+{
+    double  min, avg, max;
+};
+
+/* Shortest, average and longest of the edges; all zero without edges */
+EdgeLengths     edge_lengths(const PointStore&, const std::vector<uint64_t>&);
+
+/* The edges of all the elements, each element having its point indices
+ * sorted, in no particular order and with duplicates */
+template<typename T>
+void
+element_edges(const T *elems, size_t count, std::vector<uint64_t>& keys)
+{
+    static_assert(sizeof(typename T::index_type) <= sizeof(uint32_t),
+                  "Point indices do not fit edge keys");
+    
+    const size_t npts = std::tuple_size<decltype(elems->points())>::value;
+    const size_t per_elem = npts*(npts-1)/2;
+    const size_t chunk = 65536;
+    
+    keys.resize(count*per_elem);
+    
+    parallel_for((count + chunk - 1)/chunk, [&](size_t c) {
+        size_t end = std::min(count, (c+1)*chunk);
+        uint64_t *out = keys.data() + c*chunk*per_elem;
+        
+        for (size_t e = c*chunk; e < end; e++)
+        {
+            auto pts = elems[e].points();
+            
+            for (size_t i = 0; i < pts.size(); i++)
+                for (size_t j = i+1; j < pts.size(); j++)
+                    *out++ = edge_key(pts[i], pts[j]);
+        }
+    });
+}
+
+/* The distinct edges of the elements, sorted */
+template<typename T>
+std::vector<uint64_t>
+unique_edges(const T *elems, size_t count)
+{
+    std::vector<uint64_t> keys;
+    
+    element_edges(elems, count, keys);
+    sort_unique_keys(keys);
+    
+    return keys;
+}
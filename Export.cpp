@@ -0,0 +1,269 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <cstring>
+
+#include <QRunnable>
+#include <QThread>
+
+#include "Export.h"
+#include "Snapshot.h"
+
+struct ExportSink
+{
+    QString             base;       /* PNG files: path without suffix */
+    bool                raw;
+    std::ofstream       video;
+    int                 width, height;
+    std::atomic<int>    failures;
+};
+
+/* Writes one frame and frees its place in the queue */
+class FrameEncoder : public QRunnable
+{
+    std::shared_ptr<ExportSink>     _sink;
+    size_t                          _index;
+    std::vector<uint32_t>           _pixels;
+    QSemaphore                      *_queue;
+    
+public:
+    FrameEncoder(std::shared_ptr<ExportSink> sink, size_t index,
+                 std::vector<uint32_t>& pixels, QSemaphore *queue)
+        : _sink(sink), _index(index), _queue(queue)
+    {
+        _pixels.swap(pixels);
+    }
+    
+    void
+    run(void)
+    {
+        bool ok;
+        
+        if (_sink->raw)
+        {
+            _sink->video.write((const char *)_pixels.data(),
+                               _pixels.size()*sizeof(uint32_t));
+            ok = _sink->video.good();
+        }
+        else
+        {
+            QString path = QString("%1_%2.png").arg(_sink->base)
+                                               .arg(_index, 4, 10, QChar('0'));
+            ok = save_png(path, _pixels.data(), _sink->width, _sink->height);
+        }
+        
+        if (!ok)
+            _sink->failures++;
+        
+        _queue->release();
+    }
+};
+
+FrameExporter::FrameExporter(const GLFunctions& gl)
+    : _gl(gl), _framebuffer(0), _color(0), _depth(0), _width(0), _height(0),
+      _captured(0), _encoded(0), _queue(EXPORT_QUEUE)
+{
+    for (auto& p : _pixels)
+        p = 0;
+}
+
+FrameExporter::~FrameExporter()
+{
+    _encoders.waitForDone();
+    release();
+}
+
+bool
+FrameExporter::begin(const QString& path, int width, int height)
+{
+    _width = width;
+    _height = height;
+    _captured = _encoded = 0;
+    
+    _sink = std::make_shared<ExportSink>();
+    _sink->raw = path.endsWith(".raw", Qt::CaseInsensitive);
+    _sink->width = width;
+    _sink->height = height;
+    _sink->failures = 0;
+    
+    if (_sink->raw)
+    {
+        _sink->video.open(path.toStdString().c_str(),
+                          std::ios::out | std::ios::binary | std::ios::trunc);
+        if ( !_sink->video.is_open() )
+        {
+            std::cout << "Cannot write " << path.toStdString() << std::endl;
+            return false;
+        }
+    }
+    else
+    {
+        _sink->base = path;
+        if ( path.endsWith(".png", Qt::CaseInsensitive) )
+            _sink->base.chop(4);
+    }
+    
+    /* Raw frames are appended in order, PNG files are independent */
+    _encoders.setMaxThreadCount(_sink->raw ? 1 : QThread::idealThreadCount());
+    
+    _gl.GenRenderbuffers(1, &_color);
+    _gl.BindRenderbuffer(GL_RENDERBUFFER, _color);
+    _gl.RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    
+    _gl.GenRenderbuffers(1, &_depth);
+    _gl.BindRenderbuffer(GL_RENDERBUFFER, _depth);
+    _gl.RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+                            width, height);
+    _gl.BindRenderbuffer(GL_RENDERBUFFER, 0);
+    
+    _gl.GenFramebuffers(1, &_framebuffer);
+    _gl.BindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    _gl.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                GL_RENDERBUFFER, _color);
+    _gl.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                GL_RENDERBUFFER, _depth);
+    
+    GLenum status = _gl.CheckFramebufferStatus(GL_FRAMEBUFFER);
+    _gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Cannot render to a " << width << "x" << height
+                  << " framebuffer" << std::endl;
+        release();
+        return false;
+    }
+    
+    ptrdiff_t size = ptrdiff_t(width)*height*sizeof(uint32_t);
+    
+    _gl.GenBuffers(EXPORT_BUFFERS, _pixels);
+    for (auto p : _pixels)
+    {
+        _gl.BindBuffer(GL_PIXEL_PACK_BUFFER, p);
+        _gl.BufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    }
+    _gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    
+    return true;
+}
+
+void
+FrameExporter::target(void)
+{
+    _gl.BindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glViewport(0, 0, _width, _height);
+}
+
+/* The readback only gets queued here */
+void
+FrameExporter::capture(void)
+{
+    _gl.BindBuffer(GL_PIXEL_PACK_BUFFER, _pixels[_captured % EXPORT_BUFFERS]);
+    glReadPixels(0, 0, _width, _height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+                 nullptr);
+    _gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    _gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
+    
+    if (++_captured - _encoded == EXPORT_BUFFERS)
+        encode_oldest();
+}
+
+/* Copies the pixels out of the buffer, top row first, so that it can
+ * take the next frame; blocks while the encoders are EXPORT_QUEUE
+ * frames behind */
+void
+FrameExporter::encode_oldest(void)
+{
+    size_t row = _width, rows = _height;
+    
+    _gl.BindBuffer(GL_PIXEL_PACK_BUFFER, _pixels[_encoded % EXPORT_BUFFERS]);
+    const uint32_t *mapped = (const uint32_t *)
+        _gl.MapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                           row*rows*sizeof(uint32_t), GL_MAP_READ_BIT);
+    
+    std::vector<uint32_t> frame;
+    
+    if (mapped)
+    {
+        frame.resize(row*rows);
+        for (size_t y = 0; y < rows; y++)
+            memcpy(&frame[y*row], mapped + (rows-1-y)*row,
+                   row*sizeof(uint32_t));
+        
+        _gl.UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    
+    _gl.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    
+    if (!mapped)
+        _sink->failures++;
+    else
+    {
+        _queue.acquire();
+        _encoders.start( new FrameEncoder(_sink, _encoded, frame, &_queue) );
+    }
+    
+    _encoded++;
+}
+
+bool
+FrameExporter::finish(void)
+{
+    while (_encoded < _captured)
+        encode_oldest();
+    
+    _encoders.waitForDone();
+    release();
+    
+    if (_sink->raw)
+        _sink->video.close();
+    
+    return _sink->failures == 0;
+}
+
+void
+FrameExporter::release(void)
+{
+    if (_pixels[0])
+        _gl.DeleteBuffers(EXPORT_BUFFERS, _pixels);
+    if (_framebuffer)
+        _gl.DeleteFramebuffers(1, &_framebuffer);
+    if (_color)
+        _gl.DeleteRenderbuffers(1, &_color);
+    if (_depth)
+        _gl.DeleteRenderbuffers(1, &_depth);
+    
+    for (auto& p : _pixels)
+        p = 0;
+    _framebuffer = _color = _depth = 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+#include <QString>
+#include <QThreadPool>
+#include <QSemaphore>
+
+#include "GLFunctions.h"
+
+/* Pixel buffer objects frames are read back through */
+#define EXPORT_BUFFERS      3
+
+/* Frames read back and waiting for the encoders, at most */
+#define EXPORT_QUEUE        8
+
+struct ExportSink;
+
+/*******************************************************************/
+/* Writes a sequence of frames rendered at a given size, either as
+ * numbered PNG files or as a single raw video file, when the path ends
+ * in .raw: frames of 32 bit BGRA pixels, top row first, one after the
+ * other.
+ *
+ * Frames are drawn into a framebuffer object and read back into a ring
+ * of EXPORT_BUFFERS pixel buffer objects: the readback of a frame is
+ * only mapped EXPORT_BUFFERS-1 frames later, when the GPU is done with
+ * it, so that rendering never waits for the transfer. The pixels are
+ * then encoded on a thread pool while the next frames are rendered.
+ *
+ * All the calls but the constructor need the context of the GL
+ * functions to be current.
+ */
+class FrameExporter
+{
+    const GLFunctions&              _gl;
+    GLuint                          _framebuffer, _color, _depth;
+    GLuint                          _pixels[EXPORT_BUFFERS];
+    int                             _width, _height;
+    
+    /* Frames read back, and the ones handed to the encoders */
+    size_t                          _captured, _encoded;
+    
+    std::shared_ptr<ExportSink>     _sink;
+    QThreadPool                     _encoders;
+    QSemaphore                      _queue;
+    
+    void    encode_oldest(void);
+    void    release(void);
+    
+public:
+    FrameExporter(const GLFunctions&);
+    ~FrameExporter();
+    
+    bool    begin(const QString&, int, int);
+    
+    /* Frames are drawn between target() and capture() */
+    void    target(void);
+    void    capture(void);
+    
+    /* Waits for all the frames to be written; false if any was not */
+    bool    finish(void);
+};
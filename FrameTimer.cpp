@@ -0,0 +1,107 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FrameTimer.h"
+
+/*****************************************************************************/
+FrameTimer::FrameTimer()
+    : _gl(nullptr), _issued(0), _read(0), _running(false)
+{}
+
+bool
+FrameTimer::initialize(const GLFunctions& gl)
+{
+    release();
+    
+    if ( !gl.GenQueries || !gl.GetQueryObjectui64v ||
+         !(gl.versionAtLeast(3, 3) || gl.hasExtension("GL_ARB_timer_query")) )
+        return false;
+    
+    _gl = &gl;
+    _gl->GenQueries(TIMER_QUERIES, _queries);
+    return true;
+}
+
+void
+FrameTimer::release(void)
+{
+    if (_gl)
+        _gl->DeleteQueries(TIMER_QUERIES, _queries);
+    
+    _gl = nullptr;
+    _issued = _read = 0;
+    _running = false;
+}
+
+void
+FrameTimer::begin(void)
+{
+    if ( !_gl || _issued - _read == TIMER_QUERIES )
+        return;
+    
+    _gl->BeginQuery(GL_TIME_ELAPSED, _queries[_issued % TIMER_QUERIES]);
+    _running = true;
+}
+
+void
+FrameTimer::end(void)
+{
+    if (!_running)
+        return;
+    
+    _gl->EndQuery(GL_TIME_ELAPSED);
+    _issued++;
+    _running = false;
+}
+
+bool
+FrameTimer::elapsed(double& ms)
+{
+    bool found = false;
+    
+    while (_read < _issued)
+    {
+        GLuint query = _queries[_read % TIMER_QUERIES];
+        GLint available = 0;
+        
+        _gl->GetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+        
+        uint64_t ns = 0;
+        _gl->GetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        _read++;
+        
+        ms = ns/1e6;
+        found = true;
+    }
+    
+    return found;
+}
@@ -0,0 +1,67 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "GLFunctions.h"
+
+/* Timer queries in flight, at most */
+#define TIMER_QUERIES   4
+
+/*******************************************************************/
+/* GPU time of frames, measured with timer queries that are read back
+ * once the GPU is done with them, a frame or more later, instead of
+ * waiting for it. Frames started while all the queries are in flight
+ * are not timed. Needs OpenGL 3.3 or ARB_timer_query; without them
+ * nothing is timed.
+ */
+class FrameTimer
+{
+    const GLFunctions   *_gl;
+    GLuint              _queries[TIMER_QUERIES];
+    size_t              _issued, _read;
+    bool                _running;
+    
+public:
+    FrameTimer();
+    
+    /* With the context current */
+    bool    initialize(const GLFunctions&);
+    void    release(void);
+    
+    void    begin(void);
+    void    end(void);
+    
+    /* Time of the latest frame whose result came in since the last
+     * call; false if there is none */
+    bool    elapsed(double& ms);
+};
@@ -0,0 +1,151 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+
+#include "GLFunctions.h"
+
+GLFunctions::GLFunctions()
+{
+    memset(this, 0, sizeof(*this));
+}
+
+#define GL_RESOLVE(fn)                                                  \
+    fn = reinterpret_cast<decltype(fn)>( resolver("gl" #fn) );          \
+    if (!fn)                                                            \
+    {                                                                   \
+        std::cout << "OpenGL function gl" #fn " is not available"       \
+                  << std::endl;                                         \
+        ok = false;                                                     \
+    }
+
+#define GL_RESOLVE_OPTIONAL(fn)                                         \
+    fn = reinterpret_cast<decltype(fn)>( resolver("gl" #fn) );
+
+bool
+GLFunctions::resolve(const Resolver& resolver)
+{
+    bool ok = true;
+    
+    GL_RESOLVE(GenBuffers);
+    GL_RESOLVE(DeleteBuffers);
+    GL_RESOLVE(BindBuffer);
+    GL_RESOLVE(BufferData);
+    GL_RESOLVE(BufferSubData);
+    GL_RESOLVE(CopyBufferSubData);
+    GL_RESOLVE(MapBufferRange);
+    GL_RESOLVE(UnmapBuffer);
+    
+    GL_RESOLVE(CreateShader);
+    GL_RESOLVE(DeleteShader);
+    GL_RESOLVE(ShaderSource);
+    GL_RESOLVE(CompileShader);
+    GL_RESOLVE(GetShaderiv);
+    GL_RESOLVE(GetShaderInfoLog);
+    
+    GL_RESOLVE(CreateProgram);
+    GL_RESOLVE(DeleteProgram);
+    GL_RESOLVE(AttachShader);
+    GL_RESOLVE(BindAttribLocation);
+    GL_RESOLVE(LinkProgram);
+    GL_RESOLVE(GetProgramiv);
+    GL_RESOLVE(GetProgramInfoLog);
+    GL_RESOLVE(UseProgram);
+    GL_RESOLVE(GetUniformLocation);
+    GL_RESOLVE(Uniform1i);
+    GL_RESOLVE(Uniform4f);
+    GL_RESOLVE(UniformMatrix4fv);
+    
+    GL_RESOLVE(ActiveTexture);
+    GL_RESOLVE(TexBuffer);
+    
+    GL_RESOLVE(GenFramebuffers);
+    GL_RESOLVE(DeleteFramebuffers);
+    GL_RESOLVE(BindFramebuffer);
+    GL_RESOLVE(FramebufferTexture2D);
+    GL_RESOLVE(FramebufferRenderbuffer);
+    GL_RESOLVE(CheckFramebufferStatus);
+    GL_RESOLVE(GenRenderbuffers);
+    GL_RESOLVE(DeleteRenderbuffers);
+    GL_RESOLVE(BindRenderbuffer);
+    GL_RESOLVE(RenderbufferStorage);
+    GL_RESOLVE(DrawBuffers);
+    GL_RESOLVE(ClearBufferfv);
+    
+    GL_RESOLVE(VertexAttribPointer);
+    GL_RESOLVE(EnableVertexAttribArray);
+    GL_RESOLVE(DisableVertexAttribArray);
+    
+    GL_RESOLVE_OPTIONAL(GetStringi);
+    GL_RESOLVE_OPTIONAL(BindBufferBase);
+    GL_RESOLVE_OPTIONAL(BlendFunci);
+    GL_RESOLVE_OPTIONAL(MultiDrawElementsIndirect);
+    GL_RESOLVE_OPTIONAL(GenQueries);
+    GL_RESOLVE_OPTIONAL(DeleteQueries);
+    GL_RESOLVE_OPTIONAL(BeginQuery);
+    GL_RESOLVE_OPTIONAL(EndQuery);
+    GL_RESOLVE_OPTIONAL(GetQueryObjectiv);
+    GL_RESOLVE_OPTIONAL(GetQueryObjectui64v);
+    
+    return ok;
+}
+
+bool
+GLFunctions::versionAtLeast(int major, int minor) const
+{
+    const char *version = (const char *) glGetString(GL_VERSION);
+    int ctx_major, ctx_minor;
+    
+    if ( !version || sscanf(version, "%d.%d", &ctx_major, &ctx_minor) != 2 )
+        return false;
+    
+    return ctx_major > major || (ctx_major == major && ctx_minor >= minor);
+}
+
+bool
+GLFunctions::hasExtension(const char *name) const
+{
+    if (!GetStringi)
+        return false;
+    
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    
+    for (GLint i = 0; i < count; i++)
+    {
+        const char *ext = (const char *) GetStringi(GL_EXTENSIONS, i);
+        if ( ext && !strcmp(ext, name) )
+            return true;
+    }
+    
+    return false;
+}
@@ -0,0 +1,228 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+#include <QGLWidget>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+#ifndef APIENTRYP
+#define APIENTRYP APIENTRY *
+#endif
+
+/* OpenGL 1.5 to 4.3 enums, for headers that stop at 1.1 */
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER             0x8892
+#define GL_ELEMENT_ARRAY_BUFFER     0x8893
+#define GL_STATIC_DRAW              0x88E4
+#define GL_DYNAMIC_DRAW             0x88E8
+#endif
+
+#ifndef GL_COPY_READ_BUFFER
+#define GL_COPY_READ_BUFFER         0x8F36
+#define GL_COPY_WRITE_BUFFER        0x8F37
+#endif
+
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER        0x88EB
+#define GL_STREAM_READ              0x88E1
+#endif
+
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT             0x0001
+#endif
+
+#ifndef GL_BGRA
+#define GL_BGRA                     0x80E1
+#endif
+
+#ifndef GL_UNSIGNED_INT_8_8_8_8_REV
+#define GL_UNSIGNED_INT_8_8_8_8_REV 0x8367
+#endif
+
+#ifndef GL_TEXTURE1
+#define GL_TEXTURE0                 0x84C0
+#define GL_TEXTURE1                 0x84C1
+#endif
+
+#ifndef GL_TEXTURE_BUFFER
+#define GL_TEXTURE_BUFFER           0x8C2A
+#endif
+
+#ifndef GL_RGBA32F
+#define GL_RGBA32F                  0x8814
+#endif
+
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER              0x8D40
+#define GL_RENDERBUFFER             0x8D41
+#define GL_FRAMEBUFFER_BINDING      0x8CA6
+#define GL_FRAMEBUFFER_COMPLETE     0x8CD5
+#define GL_COLOR_ATTACHMENT0        0x8CE0
+#define GL_COLOR_ATTACHMENT1        0x8CE1
+#define GL_DEPTH_ATTACHMENT         0x8D00
+#endif
+
+#ifndef GL_RGBA16F
+#define GL_RGBA16F                  0x881A
+#define GL_HALF_FLOAT               0x140B
+#endif
+
+#ifndef GL_R8
+#define GL_R8                       0x8229
+#endif
+
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24        0x81A6
+#endif
+
+#ifndef GL_NUM_EXTENSIONS
+#define GL_NUM_EXTENSIONS           0x821D
+#endif
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER     0x8F3F
+#endif
+
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER    0x90D2
+#endif
+
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED             0x88BF
+#endif
+
+#ifndef GL_QUERY_RESULT
+#define GL_QUERY_RESULT             0x8866
+#define GL_QUERY_RESULT_AVAILABLE   0x8867
+#endif
+
+#ifndef GL_VERTEX_SHADER
+#define GL_FRAGMENT_SHADER          0x8B30
+#define GL_VERTEX_SHADER            0x8B31
+#define GL_COMPILE_STATUS           0x8B81
+#define GL_LINK_STATUS              0x8B82
+#define GL_INFO_LOG_LENGTH          0x8B84
+#endif
+
+/*******************************************************************/
+/* Entry points beyond OpenGL 1.1, looked up at run time through a
+ * resolver, so that the same code runs on any context: a QGLContext,
+ * or an offscreen one. resolve() fails if any of the required ones is
+ * missing; the optional ones are left null, and callers check both the
+ * pointer and the version or extension that provides it.
+ */
+class GLFunctions
+{
+public:
+    typedef std::function<void *(const char *)>     Resolver;
+    
+    void    (APIENTRYP GenBuffers)(GLsizei, GLuint *);
+    void    (APIENTRYP DeleteBuffers)(GLsizei, const GLuint *);
+    void    (APIENTRYP BindBuffer)(GLenum, GLuint);
+    void    (APIENTRYP BufferData)(GLenum, ptrdiff_t, const void *, GLenum);
+    void    (APIENTRYP BufferSubData)(GLenum, ptrdiff_t, ptrdiff_t, const void *);
+    void    (APIENTRYP CopyBufferSubData)(GLenum, GLenum, ptrdiff_t, ptrdiff_t,
+                                          ptrdiff_t);
+    void *  (APIENTRYP MapBufferRange)(GLenum, ptrdiff_t, ptrdiff_t, GLbitfield);
+    GLboolean (APIENTRYP UnmapBuffer)(GLenum);
+    
+    GLuint  (APIENTRYP CreateShader)(GLenum);
+    void    (APIENTRYP DeleteShader)(GLuint);
+    void    (APIENTRYP ShaderSource)(GLuint, GLsizei, const char * const *, const GLint *);
+    void    (APIENTRYP CompileShader)(GLuint);
+    void    (APIENTRYP GetShaderiv)(GLuint, GLenum, GLint *);
+    void    (APIENTRYP GetShaderInfoLog)(GLuint, GLsizei, GLsizei *, char *);
+    
+    GLuint  (APIENTRYP CreateProgram)(void);
+    void    (APIENTRYP DeleteProgram)(GLuint);
+    void    (APIENTRYP AttachShader)(GLuint, GLuint);
+    void    (APIENTRYP BindAttribLocation)(GLuint, GLuint, const char *);
+    void    (APIENTRYP LinkProgram)(GLuint);
+    void    (APIENTRYP GetProgramiv)(GLuint, GLenum, GLint *);
+    void    (APIENTRYP GetProgramInfoLog)(GLuint, GLsizei, GLsizei *, char *);
+    void    (APIENTRYP UseProgram)(GLuint);
+    GLint   (APIENTRYP GetUniformLocation)(GLuint, const char *);
+    void    (APIENTRYP Uniform1i)(GLint, GLint);
+    void    (APIENTRYP Uniform4f)(GLint, GLfloat, GLfloat, GLfloat, GLfloat);
+    void    (APIENTRYP UniformMatrix4fv)(GLint, GLsizei, GLboolean,
+                                         const GLfloat *);
+    
+    void    (APIENTRYP ActiveTexture)(GLenum);
+    void    (APIENTRYP TexBuffer)(GLenum, GLenum, GLuint);
+    
+    void    (APIENTRYP GenFramebuffers)(GLsizei, GLuint *);
+    void    (APIENTRYP DeleteFramebuffers)(GLsizei, const GLuint *);
+    void    (APIENTRYP BindFramebuffer)(GLenum, GLuint);
+    void    (APIENTRYP FramebufferTexture2D)(GLenum, GLenum, GLenum, GLuint,
+                                             GLint);
+    void    (APIENTRYP FramebufferRenderbuffer)(GLenum, GLenum, GLenum,
+                                                GLuint);
+    GLenum  (APIENTRYP CheckFramebufferStatus)(GLenum);
+    void    (APIENTRYP GenRenderbuffers)(GLsizei, GLuint *);
+    void    (APIENTRYP DeleteRenderbuffers)(GLsizei, const GLuint *);
+    void    (APIENTRYP BindRenderbuffer)(GLenum, GLuint);
+    void    (APIENTRYP RenderbufferStorage)(GLenum, GLenum, GLsizei, GLsizei);
+    void    (APIENTRYP DrawBuffers)(GLsizei, const GLenum *);
+    void    (APIENTRYP ClearBufferfv)(GLenum, GLint, const GLfloat *);
+    
+    void    (APIENTRYP VertexAttribPointer)(GLuint, GLint, GLenum, GLboolean,
+                                            GLsizei, const void *);
+    void    (APIENTRYP EnableVertexAttribArray)(GLuint);
+    void    (APIENTRYP DisableVertexAttribArray)(GLuint);
+    
+    /* Optional */
+    const GLubyte * (APIENTRYP GetStringi)(GLenum, GLuint);
+    void    (APIENTRYP BindBufferBase)(GLenum, GLuint, GLuint);
+    void    (APIENTRYP BlendFunci)(GLuint, GLenum, GLenum);
+    void    (APIENTRYP MultiDrawElementsIndirect)(GLenum, GLenum, const void *,
+                                                  GLsizei, GLsizei);
+    void    (APIENTRYP GenQueries)(GLsizei, GLuint *);
+    void    (APIENTRYP DeleteQueries)(GLsizei, const GLuint *);
+    void    (APIENTRYP BeginQuery)(GLenum, GLuint);
+    void    (APIENTRYP EndQuery)(GLenum);
+    void    (APIENTRYP GetQueryObjectiv)(GLuint, GLenum, GLint *);
+    void    (APIENTRYP GetQueryObjectui64v)(GLuint, GLenum, uint64_t *);
+    
+    GLFunctions();
+    
+    bool    resolve(const Resolver&);
+    
+    /* About the current context */
+    bool    versionAtLeast(int, int) const;
+    bool    hasExtension(const char *) const;
+};
@@ -0,0 +1,566 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+#include "GmshMesh.h"
+
+#define NO_INDEX    size_t(-1)
+
+namespace {
+
+/* Bounds checked, unaligned reads of native byte order values */
+class BinaryReader
+{
+    const char      *&_pos;
+    const char      *_end;
+    
+public:
+    BinaryReader(const char *& pos, const char *end)
+        : _pos(pos), _end(end)
+    {}
+    
+    template<typename T>
+    bool
+    read(T& val)
+    {
+        if ( size_t(_end - _pos) < sizeof(T) )
+            return false;
+        
+        memcpy(&val, _pos, sizeof(T));
+        _pos += sizeof(T);
+        return true;
+    }
+    
+    /* Returns the start of the next n bytes and skips them */
+    const char *
+    take(size_t n)
+    {
+        if ( size_t(_end - _pos) < n )
+            return nullptr;
+        
+        const char *ret = _pos;
+        _pos += n;
+        return ret;
+    }
+    
+    /* Same for n items of the given size, n coming from the file: the
+     * count is checked before it is multiplied */
+    const char *
+    take_array(uint64_t n, size_t size)
+    {
+        if ( n > size_t(_end - _pos)/size )
+            return nullptr;
+        
+        return take(n*size);
+    }
+};
+
+/* Number of nodes of the Gmsh element types, 0 for unknown types */
+size_t
+element_nodes(int type)
+{
+    switch (type)
+    {
+        case 15: return 1;
+        case 1:  return 2;
+        case 2:  return 3;
+        case 3:  return 4;
+        case 4:  return 4;
+        case 5:  return 8;
+        case 6:  return 6;
+        case 7:  return 5;
+        case 8:  return 3;
+        case 9:  return 6;
+        case 10: return 9;
+        case 11: return 10;
+        case 12: return 27;
+        case 13: return 18;
+        case 14: return 14;
+        case 16: return 8;
+        case 17: return 20;
+        case 18: return 15;
+        case 19: return 13;
+        case 20: return 9;
+        case 21: return 10;
+        case 22: return 12;
+        case 23: return 15;
+        case 24: return 15;
+        case 25: return 21;
+        case 26: return 4;
+        case 27: return 5;
+        case 28: return 6;
+        case 29: return 20;
+        case 30: return 35;
+        case 31: return 56;
+        case 92: return 64;
+        case 93: return 125;
+        default: return 0;
+    }
+}
+
+bool
+is_tetrahedron(int type)
+{
+    return type == 4 || type == 11 || type == 29 || type == 30 || type == 31;
+}
+
+bool
+is_triangle(int type)
+{
+    return type == 2 || type == 9 || (type >= 20 && type <= 25);
+}
+
+bool
+is_quadrangle(int type)
+{
+    return type == 3 || type == 10 || type == 16;
+}
+
+void
+skip_ws(const char *& pos, const char *end)
+{
+    while ( pos < end && (*pos == ' ' || *pos == '\n' || *pos == '\r' || *pos == '\t') )
+        pos++;
+}
+
+/* Reads a "$Name" line. Returns false at the end of the file. */
+bool
+section_start(const char *& pos, const char *end, std::string& name)
+{
+    skip_ws(pos, end);
+    
+    if (pos == end)
+        return false;
+    
+    name.clear();
+    if (*pos != '$')
+        return true;
+    
+    const char *nl = std::find(pos, end, '\n');
+    name.assign(pos+1, nl);
+    if ( !name.empty() && name[name.size()-1] == '\r' )
+        name.resize(name.size()-1);
+    
+    pos = (nl == end) ? end : nl+1;
+    return true;
+}
+
+/* Expects the "$EndName" line after the binary contents of a section */
+bool
+section_end(const char *& pos, const char *end, const std::string& name)
+{
+    std::string marker = "$End" + name;
+    
+    skip_ws(pos, end);
+    
+    if ( size_t(end - pos) < marker.size() ||
+         strncmp(pos, marker.c_str(), marker.size()) != 0 )
+        return false;
+    
+    pos = std::find(pos, end, '\n');
+    return true;
+}
+
+/* Sections that are not needed are skipped up to their end marker */
+bool
+section_skip(const char *& pos, const char *end, const std::string& name)
+{
+    std::string marker = "$End" + name;
+    
+    pos = std::search(pos, end, marker.begin(), marker.end());
+    if (pos == end)
+        return false;
+    
+    pos = std::find(pos, end, '\n');
+    return true;
+}
+
+} // namespace
+
+/*****************************************************************************/
+GmshMesh::GmshMesh()
+    : _minNodeTag(0), _skipped(0), _data(nullptr)
+{}
+
+/* For each entity: tag, bounding box, physical tags and, except for
+ * points, the bounding entities. Only surfaces and volumes matter. */
+bool
+GmshMesh::read_entities(const char *& pos, const char *end)
+{
+    BinaryReader    rd(pos, end);
+    uint64_t        num[4];
+    
+    for (size_t d = 0; d < 4; d++)
+        if ( !rd.read(num[d]) )
+            return false;
+    
+    for (size_t d = 0; d < 4; d++)
+    {
+        for (uint64_t i = 0; i < num[d]; i++)
+        {
+            int32_t     tag, phys;
+            uint64_t    nphys, nbound;
+            
+            if ( !rd.read(tag) || !rd.take( (d == 0 ? 3 : 6)*sizeof(double) ) ||
+                 !rd.read(nphys) )
+                return false;
+            
+            size_t zone = tag;
+            for (uint64_t p = 0; p < nphys; p++)
+            {
+                if ( !rd.read(phys) )
+                    return false;
+                if (p == 0)
+                    zone = phys;
+            }
+            
+            if (d > 0 && ( !rd.read(nbound) ||
+                           !rd.take_array(nbound, sizeof(int32_t)) ))
+                return false;
+            
+            if (d == 2)
+                _surfaceZones[tag] = zone;
+            else if (d == 3)
+                _volumeZones[tag] = zone;
+        }
+    }
+    
+    return true;
+}
+
+/* Blocks of node tags followed by their coordinates */
+bool
+GmshMesh::read_nodes(const char *& pos, const char *end)
+{
+    BinaryReader    rd(pos, end);
+    uint64_t        nblocks, nnodes, mintag, maxtag;
+    
+    if ( !rd.read(nblocks) || !rd.read(nnodes) ||
+         !rd.read(mintag) || !rd.read(maxtag) )
+        return false;
+    
+    if ( !check_point_count(nnodes) )
+        return false;
+    
+    /* Gmsh numbers nodes densely unless told otherwise; refuse tag
+     * ranges that would make the lookup table explode. The span is
+     * compared before adding 1, which wraps for the full range. */
+    if ( nnodes && (maxtag < mintag ||
+                    maxtag - mintag >= 16*nnodes + (1 << 20)) )
+    {
+        std::cout << "Gmsh node tags are too sparse" << std::endl;
+        return false;
+    }
+    
+    uint64_t range = nnodes ? maxtag - mintag + 1 : 0;
+    
+    _minNodeTag = mintag;
+    _nodeIndex.assign(range, NO_INDEX);
+    _points.reserve(nnodes);
+    
+    uint64_t nread = 0;
+    for (uint64_t b = 0; b < nblocks; b++)
+    {
+        int32_t     dim, tag, parametric;
+        uint64_t    n;
+        
+        if ( !rd.read(dim) || !rd.read(tag) || !rd.read(parametric) ||
+             !rd.read(n) )
+            return false;
+        
+        /* More nodes than announced would overflow the point indices */
+        if ( dim < 0 || dim > 3 || n > nnodes - nread )
+            return false;
+        
+        nread += n;
+        
+        size_t ncoords = 3 + (parametric ? dim : 0);
+        const char *tags = rd.take_array(n, sizeof(uint64_t));
+        const char *coords = rd.take_array(n, ncoords*sizeof(double));
+        
+        if (!tags || !coords)
+            return false;
+        
+        for (uint64_t i = 0; i < n; i++)
+        {
+            uint64_t    t;
+            double      xyz[3];
+            
+            memcpy(&t, tags + i*sizeof(uint64_t), sizeof(uint64_t));
+            memcpy(xyz, coords + i*ncoords*sizeof(double), sizeof(xyz));
+            
+            if (t < mintag || t > maxtag)
+                return false;
+            
+            _nodeIndex[t - mintag] = _points.size();
+            _points.push_back(xyz[0], xyz[1], xyz[2]);
+        }
+        
+        if ( !report_progress(pos - _data) )
+            return false;
+    }
+    
+    return true;
+}
+
+/* Blocks of elements of one type, each element being its tag followed
+ * by its node tags. Blocks of tetrahedrons and triangles are copied to
+ * the zone connectivity in one go, everything else is skipped. */
+bool
+GmshMesh::read_elements(const char *& pos, const char *end)
+{
+    BinaryReader    rd(pos, end);
+    uint64_t        nblocks, nelems, mintag, maxtag;
+    
+    if ( !rd.read(nblocks) || !rd.read(nelems) ||
+         !rd.read(mintag) || !rd.read(maxtag) )
+        return false;
+    
+    for (uint64_t b = 0; b < nblocks; b++)
+    {
+        int32_t     dim, tag, type;
+        uint64_t    n;
+        
+        if ( !rd.read(dim) || !rd.read(tag) || !rd.read(type) || !rd.read(n) )
+            return false;
+        
+        size_t nn = element_nodes(type);
+        if (nn == 0)
+        {
+            std::cout << "Unknown Gmsh element type " << type << std::endl;
+            return false;
+        }
+        
+        size_t stride = (1 + nn)*sizeof(uint64_t);
+        const char *data = rd.take_array(n, stride);
+        if (!data)
+            return false;
+        
+        bool tets = (dim == 3 && is_tetrahedron(type));
+        bool tris = (dim == 2 && is_triangle(type));
+        bool quads = (dim == 2 && is_quadrangle(type));
+        
+        if ( !tets && !tris && !quads )
+        {
+            if (dim >= 2)
+                _skipped += n;
+            continue;
+        }
+        
+        std::map<int, size_t>& zones = (dim == 3) ? _volumeZones : _surfaceZones;
+        auto zitor = zones.find(tag);
+        size_t zone = (zitor == zones.end()) ? size_t(tag) : zitor->second;
+        
+        /* Element vertices, as point indices */
+        size_t nv = tris ? 3 : 4;
+        size_t v[4];
+        
+        auto vertices = [&](const char *rec) -> bool {
+            uint64_t t[4];
+            memcpy(t, rec + sizeof(uint64_t), nv*sizeof(uint64_t));
+            for (size_t i = 0; i < nv; i++)
+            {
+                if (t[i] < _minNodeTag || t[i] - _minNodeTag >= _nodeIndex.size())
+                    return false;
+                v[i] = _nodeIndex[t[i] - _minNodeTag];
+                if (v[i] == NO_INDEX)
+                    return false;
+            }
+            return true;
+        };
+        
+        if (tets)
+        {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                if ( !vertices(data + i*stride) )
+                    return false;
+                _tetList.add(zone, Tetrahedron(v[0], v[1], v[2], v[3]));
+            }
+        }
+        else
+        {
+            for (uint64_t i = 0; i < n; i++)
+            {
+                if ( !vertices(data + i*stride) )
+                    return false;
+                _triList.add(zone, Triangle(v[0], v[1], v[2]));
+                if (quads)
+                    _triList.add(zone, Triangle(v[0], v[2], v[3]));
+            }
+        }
+        
+        if ( !report_progress(pos - _data) )
+            return false;
+    }
+    
+    return true;
+}
+
+bool
+GmshMesh::parse(const char *begin, const char *end, bool verbose)
+{
+    const char  *pos = begin;
+    std::string name;
+    bool        has_format = false, has_nodes = false, ok;
+    
+    _skipped = 0;
+    _data = begin;
+    _tetList = ZoneList<Tetrahedron>();
+    _triList = ZoneList<Triangle>();
+    
+    if (verbose)
+    {
+        std::cout << "Loading Gmsh mesh...";
+        std::cout.flush();
+    }
+    
+    while ( section_start(pos, end, name) )
+    {
+        if (name == "MeshFormat")
+        {
+            /* "4.1 1 8", then the integer 1 in binary to tell the byte
+             * order */
+            TextScanner sc(pos, end);
+            double      version;
+            size_t      filetype, datasize;
+            int32_t     one;
+            
+            ok = sc.read_double(version) && sc.read_size(filetype) &&
+                 sc.read_size(datasize);
+            
+            if ( ok && (version < 4.1 || version >= 5 || filetype != 1 || datasize != 8) )
+            {
+                std::cout << "Only binary MSH 4.1 files with 8 byte sizes "
+                             "are supported" << std::endl;
+                return false;
+            }
+            
+            pos = std::find(sc.position(), end, '\n');
+            if (pos != end)
+                pos++;
+            
+            BinaryReader rd(pos, end);
+            ok = ok && rd.read(one);
+            if (ok && one != 1)
+            {
+                std::cout << "Gmsh file has a foreign byte order" << std::endl;
+                return false;
+            }
+            
+            ok = ok && section_end(pos, end, name);
+            has_format = ok;
+        }
+        else if (!has_format)
+            ok = false;
+        else if (name == "Entities")
+            ok = read_entities(pos, end) && section_end(pos, end, name);
+        else if (name == "Nodes")
+            ok = has_nodes = read_nodes(pos, end) && section_end(pos, end, name);
+        else if (name == "Elements")
+            ok = has_nodes && read_elements(pos, end) && section_end(pos, end, name);
+        else if ( !name.empty() )
+            ok = section_skip(pos, end, name);
+        else
+            ok = false;
+        
+        if (!ok)
+        {
+            if (!_cancelled)
+                std::cout << "Parse error in Gmsh file at byte "
+                          << (pos - begin) << std::endl;
+            return false;
+        }
+    }
+    
+    if (!has_nodes)
+    {
+        std::cout << "Gmsh file has no nodes" << std::endl;
+        return false;
+    }
+    
+    if (verbose)
+        std::cout << "done" << std::endl;
+    
+    if (_skipped)
+        std::cout << "Skipped " << _skipped
+                  << " elements that are not triangles, quadrangles or "
+                     "tetrahedrons" << std::endl;
+    
+    _nodeIndex.clear();
+    _nodeIndex.shrink_to_fit();
+    
+    ok = _domains.assign(_tetList) && _boundaries.assign(_triList) &&
+         check_elements(true);
+    
+    _tetList = ZoneList<Tetrahedron>();
+    _triList = ZoneList<Triangle>();
+    
+    if (!ok)
+        return false;
+    
+    normalize_points();
+    
+    if (_monitor)
+    {
+        _monitor->pointsLoaded(_points);
+        for (auto& b : _boundaries)
+            _monitor->trianglesLoaded(b.data(), b.size());
+    }
+    
+    return true;
+}
+
+/* The binary sections are read with random access to whole blocks, so
+ * compressed files are inflated completely before parsing. */
+bool
+GmshMesh::parse_stream(ByteStream& stream, bool verbose)
+{
+    std::vector<char>   data;
+    const char          *cur = nullptr, *end = nullptr;
+    
+    while ( stream.refill(cur, end) )
+    {
+        data.insert(data.end(), cur, end);
+        cur = end;
+        
+        if ( !report_progress(0) )
+            return false;
+    }
+    
+    if ( stream.failed() )
+        return false;
+    
+    return parse(data.data(), data.data() + data.size(), verbose);
+}
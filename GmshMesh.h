@@ -0,0 +1,64 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <map>
+
+#include "Mesh.h"
+
+/*******************************************************************/
+/* Reader for binary Gmsh MSH 4.1 files. Tetrahedrons go to a domain
+ * per volume entity and triangles to a boundary per surface entity;
+ * when an entity carries a physical tag, the first one is used as the
+ * zone number instead of the entity tag.
+ */
+class GmshMesh : public NetgenNeutralMesh
+{
+    std::map<int, size_t>   _surfaceZones, _volumeZones;
+    std::vector<size_t>     _nodeIndex;     /* node tag - min tag -> point */
+    ZoneList<Tetrahedron>   _tetList;
+    ZoneList<Triangle>      _triList;
+    size_t                  _minNodeTag;
+    size_t                  _skipped;
+    const char              *_data;         /* start of the file */
+    
+    bool    read_entities(const char *&, const char *);
+    bool    read_nodes(const char *&, const char *);
+    bool    read_elements(const char *&, const char *);
+    
+protected:
+    virtual bool    parse(const char *, const char *, bool);
+    virtual bool    parse_stream(ByteStream&, bool);
+    
+public:
+    GmshMesh();
+};
+
@@ -0,0 +1,169 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include "Lod.h"
+#include "Edges.h"
+#include "Parallel.h"
+
+/* Triangles handled by a worker thread at a time */
+#define CHUNK_TRIS      65536
+
+std::vector<Triangle>
+cluster_triangles(const PointStore& points, const Triangle *tris,
+                  size_t count, size_t resolution)
+{
+    std::vector<Triangle> proxy;
+    
+    if (count == 0 || resolution == 0)
+        return proxy;
+    
+    resolution = std::min(resolution, size_t(1024));
+    
+    /* Points of the surface, sorted */
+    std::vector<uint64_t> pts(3*count);
+    parallel_for((count + CHUNK_TRIS - 1)/CHUNK_TRIS, [&](size_t c) {
+        size_t end = std::min(count, (c+1)*CHUNK_TRIS);
+        for (size_t t = c*CHUNK_TRIS; t < end; t++)
+            for (size_t i = 0; i < 3; i++)
+                pts[3*t + i] = tris[t][i];
+    });
+    sort_unique_keys(pts);
+    
+    double min[3], max[3];
+    for (size_t i = 0; i < 3; i++)
+    {
+        min[i] = std::numeric_limits<double>::max();
+        max[i] = -std::numeric_limits<double>::max();
+    }
+    
+    for (auto p : pts)
+    {
+        Point pt = points[p];
+        double c[3] = { pt.x(), pt.y(), pt.z() };
+        
+        for (size_t i = 0; i < 3; i++)
+        {
+            min[i] = std::min(min[i], c[i]);
+            max[i] = std::max(max[i], c[i]);
+        }
+    }
+    
+    double extent = std::max(max[0] - min[0],
+                             std::max(max[1] - min[1], max[2] - min[2]));
+    double cell = (extent > 0) ? extent/resolution : 1.0;
+    
+    /* Cell of every point, 10 bits per axis, above its position in pts:
+     * sorting groups the cells and puts the smallest point first */
+    size_t npts = pts.size();
+    std::vector<uint64_t> cells(npts);
+    
+    parallel_for((npts + CHUNK_TRIS - 1)/CHUNK_TRIS, [&](size_t c) {
+        size_t end = std::min(npts, (c+1)*CHUNK_TRIS);
+        for (size_t i = c*CHUNK_TRIS; i < end; i++)
+        {
+            Point pt = points[ pts[i] ];
+            double v[3] = { pt.x(), pt.y(), pt.z() };
+            uint64_t key = 0;
+            
+            for (size_t k = 0; k < 3; k++)
+            {
+                size_t q = std::min(size_t((v[k] - min[k])/cell), resolution-1);
+                key |= uint64_t(q) << (10*k);
+            }
+            
+            cells[i] = (key << 32) | i;
+        }
+    });
+    sort_unique_keys(cells);
+    
+    std::vector<uint32_t> rep(npts);
+    for (size_t i = 0; i < npts; )
+    {
+        size_t j = i;
+        uint32_t first = uint32_t(pts[ uint32_t(cells[i]) ]);
+        
+        while ( j < npts && (cells[j] >> 32) == (cells[i] >> 32) )
+            rep[ uint32_t(cells[j++]) ] = first;
+        
+        i = j;
+    }
+    
+    /* Triangles over the representatives, in chunk order */
+    size_t nchunks = (count + CHUNK_TRIS - 1)/CHUNK_TRIS;
+    std::vector<std::vector<Triangle>> parts(nchunks);
+    
+    parallel_for(nchunks, [&](size_t c) {
+        size_t end = std::min(count, (c+1)*CHUNK_TRIS);
+        for (size_t t = c*CHUNK_TRIS; t < end; t++)
+        {
+            uint32_t r[3];
+            for (size_t i = 0; i < 3; i++)
+            {
+                auto pos = std::lower_bound(pts.begin(), pts.end(),
+                                            uint64_t(tris[t][i]));
+                r[i] = rep[pos - pts.begin()];
+            }
+            
+            if (r[0] == r[1] || r[1] == r[2] || r[0] == r[2])
+                continue;
+            
+            parts[c].push_back( Triangle(r[0], r[1], r[2]) );
+        }
+    });
+    
+    for (auto& part : parts)
+        proxy.insert(proxy.end(), part.begin(), part.end());
+    
+    /* Duplicates are found by sorting positions rather than the
+     * triangles, so that the first of each stays where it is */
+    size_t nproxy = proxy.size();
+    std::vector<size_t> order(nproxy);
+    for (size_t i = 0; i < nproxy; i++)
+        order[i] = i;
+    
+    parallel_sort(order, [&](size_t a, size_t b) {
+        return proxy[a] < proxy[b] || (!(proxy[b] < proxy[a]) && a < b);
+    });
+    
+    std::vector<char> keep(nproxy, 0);
+    for (size_t i = 0; i < nproxy; i++)
+        keep[ order[i] ] = (i == 0 || proxy[ order[i-1] ] < proxy[ order[i] ]);
+    
+    size_t kept = 0;
+    for (size_t i = 0; i < nproxy; i++)
+        if (keep[i])
+            proxy[kept++] = proxy[i];
+    
+    proxy.resize(kept);
+    return proxy;
+}
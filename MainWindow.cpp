@@ -31,11 +31,13 @@
 #include <iostream>
 
 #include <QFileDialog>
+#include <QInputDialog>
 
 #include "MainWindow.h"
 #include "MeshGLWidget.h"
 
 MainWindow::MainWindow(QWidget *parent)
+    : _loader(nullptr)
 {
     setWindowTitle( "EMT Geometry Frontend (OpenGL) || (C) 2013-2014 Matteo Cicuttin" );
     
@@ -47,6 +49,7 @@ MainWindow::MainWindow(QWidget *parent)
     
     create_actions();
     create_menus();
+    create_statusbar();
     
     /* Main controller */
     QDockWidget *mainDW = new QDockWidget();
@@ -57,6 +60,16 @@ MainWindow::MainWindow(QWidget *parent)
             _meshWidget, SLOT(setDrawTetrahedrons(void)));
     connect(_mainController, SIGNAL(drawTrianglesRequested(void)),
             _meshWidget, SLOT(setDrawTriangles(void)));
+    connect(_mainController, SIGNAL(drawShellsRequested(void)),
+            _meshWidget, SLOT(setDrawShells(void)));
+    connect(_mainController, SIGNAL(wireframeToggled(bool)),
+            _meshWidget, SLOT(setWireframe(bool)));
+    connect(_mainController, SIGNAL(quantizedToggled(bool)),
+            _meshWidget, SLOT(setQuantized(bool)));
+    connect(_meshWidget, SIGNAL(quantizedChanged(bool)),
+            _mainController, SLOT(setQuantized(bool)));
+    connect(_mainController, SIGNAL(frameBudgetChanged(int)),
+            _meshWidget, SLOT(setFrameBudget(int)));
     connect(_mainController, SIGNAL(meshUpdated(void)),
             _meshWidget, SLOT(updateGL(void)));
     addDockWidget(Qt::LeftDockWidgetArea, mainDW);
@@ -100,11 +113,25 @@ MainWindow::MainWindow(QWidget *parent)
     statusBar()->showMessage("Ready");
 };
 
+MainWindow::~MainWindow()
+{
+    /* Do not destroy a loader thread that is still running */
+    if (_loader)
+    {
+        _loader->cancel();
+        _loader->wait();
+    }
+}
+
 void
 MainWindow::create_actions(void)
 {
     _openAction = new QAction("&Open mesh", this);
     connect(_openAction, SIGNAL(triggered()), this, SLOT(open_action()));
+    
+    _exportAction = new QAction("&Export turntable", this);
+    _exportAction->setEnabled(false);
+    connect(_exportAction, SIGNAL(triggered()), this, SLOT(export_action()));
 }
 
 void
@@ -112,14 +139,38 @@ MainWindow::create_menus(void)
 {
     _fileMenu = menuBar()->addMenu("&File");
     _fileMenu->addAction(_openAction);
+    _fileMenu->addAction(_exportAction);
+}
+
+void
+MainWindow::create_statusbar(void)
+{
+    _loadProgress = new QProgressBar();
+    _loadProgress->setRange(0, 100);
+    _loadProgress->setMaximumWidth(200);
+    _loadProgress->hide();
+    statusBar()->addPermanentWidget(_loadProgress);
+    
+    _loadCancel = new QPushButton("Cancel");
+    _loadCancel->hide();
+    statusBar()->addPermanentWidget(_loadCancel);
+    
+    _quantizationLabel = new QLabel();
+    statusBar()->addPermanentWidget(_quantizationLabel);
+    connect(_meshWidget, SIGNAL(quantizationReport(QString)),
+            _quantizationLabel, SLOT(setText(QString)));
 }
 
 void
 MainWindow::open_action(void)
 {
-    bool is_ok;
+    if (_loader)
+        return;
     
-    QString meshPath = QFileDialog::getOpenFileName(NULL, "Select a mesh to open...", QDir::homePath());
+    QString meshPath = QFileDialog::getOpenFileName(NULL, "Select a mesh to open...", QDir::homePath(),
+                                                    "All files (*);;Netgen volume meshes (*.vol);;"
+                                                    "Gmsh binary meshes (*.msh);;"
+                                                    "Compressed meshes (*.gz *.zst)");
     
     if (meshPath == "")
         return;
@@ -128,18 +179,65 @@ MainWindow::open_action(void)
     QTextStream(&message) << "Opening mesh " << meshPath << ", please wait";
     statusBar()->showMessage(message);
     
-    std::shared_ptr<NetgenNeutralMesh> new_nnm(new NetgenNeutralMesh());
-    is_ok = new_nnm->load(meshPath.toStdString(), true);
+    /* The current mesh stays on screen and usable until the new one is
+     * completely loaded */
+    _loader = new MeshLoader(meshPath, MeshLoader::makeMesh(meshPath), this);
+    connect(_loader, SIGNAL(progressChanged(int)),
+            _loadProgress, SLOT(setValue(int)));
+    connect(_loadCancel, SIGNAL(clicked()),
+            _loader, SLOT(cancel()));
+    connect(_loader, SIGNAL(finished()),
+            this, SLOT(load_finished()));
+    
+    /* Show the geometry as it gets parsed */
+    connect(_loader, SIGNAL(previewPoints(QVector<GLfloat>)),
+            _meshWidget, SLOT(addPreviewPoints(QVector<GLfloat>)),
+            Qt::QueuedConnection);
+    connect(_loader, SIGNAL(previewTriangles(QVector<GLfloat>)),
+            _meshWidget, SLOT(addPreviewTriangles(QVector<GLfloat>)),
+            Qt::QueuedConnection);
+    connect(_loader, SIGNAL(previewCleared()),
+            _meshWidget, SLOT(clearPreview()),
+            Qt::QueuedConnection);
     
-    message.clear();
+    _openAction->setEnabled(false);
+    _exportAction->setEnabled(false);
+    _loadProgress->setValue(0);
+    _loadProgress->show();
+    _loadCancel->show();
     
-    if (!is_ok)
+    _loader->start();
+}
+
+void
+MainWindow::load_finished(void)
+{
+    QString message;
+    
+    _loadProgress->hide();
+    _loadCancel->hide();
+    _openAction->setEnabled(true);
+    _exportAction->setEnabled(_nnm != nullptr);
+    
+    std::shared_ptr<NetgenNeutralMesh> new_nnm = _loader->mesh();
+    
+    if (_loader->cancelled())
+        QTextStream(&message) << "Loading cancelled";
+    else if (!new_nnm)
+        QTextStream(&message) << "Problem loading mesh " << _loader->path();
+    
+    _loader->deleteLater();
+    _loader = nullptr;
+    
+    if (!new_nnm)
     {
-        QTextStream(&message) << "Problem loading mesh";
+        _meshWidget->clearPreview();
+        statusBar()->showMessage(message);
         return;
     }
     
     _nnm = new_nnm;
+    _exportAction->setEnabled(true);
     
     _meshWidget->setMesh(_nnm);
     _mainController->setMesh(_nnm);
@@ -152,7 +250,85 @@ MainWindow::open_action(void)
     statusBar()->showMessage(message);
 }
 
+/* A full turn of the current view; the frames are drawn by the widget
+ * between the events, so the view stays usable meanwhile */
+void
+MainWindow::export_action(void)
+{
+    if (!_nnm || _loader)
+        return;
+    
+    QString path = QFileDialog::getSaveFileName(this, "Export turntable...",
+                                                QDir::homePath() + "/turntable.png",
+                                                "PNG images (*.png);;"
+                                                "Raw BGRA video (*.raw)");
+    if (path == "")
+        return;
+    
+    QStringList sizes;
+    sizes << "1280x720" << "1920x1080" << "3840x2160";
+    
+    bool ok;
+    QString size = QInputDialog::getItem(this, "Export turntable", "Frame size:",
+                                         sizes, 1, false, &ok);
+    if (!ok)
+        return;
+    
+    int width = size.section('x', 0, 0).toInt();
+    int height = size.section('x', 1, 1).toInt();
+    
+    QString message;
+    
+    if ( !_meshWidget->exportTurntable(path, width, height, TURNTABLE_FRAMES) )
+    {
+        QTextStream(&message) << "Problem exporting turntable to " << path;
+        statusBar()->showMessage(message);
+        return;
+    }
+    
+    _exportPath = path;
+    
+    QTextStream(&message) << "Exporting " << TURNTABLE_FRAMES << " frames to "
+                          << path << ", please wait";
+    statusBar()->showMessage(message);
+    
+    connect(_meshWidget, SIGNAL(exportProgress(int)),
+            _loadProgress, SLOT(setValue(int)));
+    connect(_meshWidget, SIGNAL(exportFinished(bool)),
+            this, SLOT(export_finished(bool)));
+    connect(_loadCancel, SIGNAL(clicked()),
+            _meshWidget, SLOT(cancelExport()));
+    
+    _openAction->setEnabled(false);
+    _exportAction->setEnabled(false);
+    _loadProgress->setValue(0);
+    _loadProgress->show();
+    _loadCancel->show();
+}
 
-
-
-
+void
+MainWindow::export_finished(bool ok)
+{
+    QString message;
+    
+    _loadProgress->hide();
+    _loadCancel->hide();
+    _openAction->setEnabled(true);
+    _exportAction->setEnabled(_nnm != nullptr);
+    
+    disconnect(_meshWidget, SIGNAL(exportProgress(int)),
+               _loadProgress, SLOT(setValue(int)));
+    disconnect(_meshWidget, SIGNAL(exportFinished(bool)),
+               this, SLOT(export_finished(bool)));
+    disconnect(_loadCancel, SIGNAL(clicked()),
+               _meshWidget, SLOT(cancelExport()));
+    
+    if (_meshWidget->exportCancelled())
+        QTextStream(&message) << "Turntable export cancelled";
+    else if (ok)
+        QTextStream(&message) << "Turntable exported to " << _exportPath;
+    else
+        QTextStream(&message) << "Problem exporting turntable to " << _exportPath;
+    
+    statusBar()->showMessage(message);
+}
@@ -33,10 +33,14 @@
 #include <memory>
 
 #include <QMainWindow>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QLabel>
 
 #include "MeshGLWidget.h"
 #include "Mesh.h"
 #include "ControllerWidget.h"
+#include "MeshLoader.h"
 
 class MainWindow : public QMainWindow
 {
@@ -44,6 +48,7 @@ class MainWindow : public QMainWindow
     
     QMenu                               *_fileMenu;
     QAction                             *_openAction;
+    QAction                             *_exportAction;
     MeshGLWidget                        *_meshWidget;
     
     MainControllerWidget                *_mainController;
@@ -53,13 +58,24 @@ class MainWindow : public QMainWindow
     
     std::shared_ptr<NetgenNeutralMesh>  _nnm;
     
+    MeshLoader                          *_loader;
+    QProgressBar                        *_loadProgress;
+    QPushButton                         *_loadCancel;
+    QLabel                              *_quantizationLabel;
+    QString                             _exportPath;
+    
 private:
     void    create_actions(void);
     void    create_menus(void);
+    void    create_statusbar(void);
     
 private slots:
     void    open_action(void);
+    void    export_action(void);
+    void    load_finished(void);
+    void    export_finished(bool ok);
     
 public:
     MainWindow(QWidget *parent = 0);
+    ~MainWindow();
 };
@@ -0,0 +1,98 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "MappedFile.h"
+
+/*****************************************************************************/
+MappedFile::MappedFile()
+    : _fd(-1), _addr(nullptr), _size(0)
+{}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool
+MappedFile::open(const std::string& filename)
+{
+    struct stat st;
+    
+    close();
+    
+    _fd = ::open(filename.c_str(), O_RDONLY);
+    if (_fd == -1)
+        return false;
+    
+    if ( fstat(_fd, &st) != 0 )
+    {
+        close();
+        return false;
+    }
+    
+    _size = st.st_size;
+    
+    /* mmap() refuses zero-length mappings, an empty file is still valid */
+    if (_size == 0)
+        return true;
+    
+    _addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+    if (_addr == MAP_FAILED)
+    {
+        _addr = nullptr;
+        close();
+        return false;
+    }
+    
+    /* Text parsers walk the file front to back exactly once */
+    madvise(_addr, _size, MADV_SEQUENTIAL);
+    
+    return true;
+}
+
+void
+MappedFile::close(void)
+{
+    if (_addr)
+        munmap(_addr, _size);
+    
+    if (_fd != -1)
+        ::close(_fd);
+    
+    _fd = -1;
+    _addr = nullptr;
+    _size = 0;
+}
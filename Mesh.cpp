@@ -29,12 +29,31 @@
  */
 
 #include <iostream>
+#include <cstring>
+#include <limits>
 
 #include "Mesh.h"
+#include "MappedFile.h"
+#include "Parallel.h"
+#include "Decompressor.h"
+#include "Topology.h"
 
 #define MIN(a,b) ((a < b) ? a : b)
 #define MAX(a,b) ((a < b) ? b : a)
 
+/* Files smaller than this are parsed on the calling thread only */
+#define PARALLEL_MIN_BYTES  (4 << 20)
+
+/* Records handed to a worker thread at a time */
+#define CHUNK_RECORDS       65536
+
+/* Records between two progress reports of the sequential reader */
+#define PROGRESS_RECORDS    16384
+
+/* Part of the progress of a parallel load given to the pre-scan, as a
+ * divisor of the input size */
+#define PRESCAN_SHARE       8
+
 /*****************************************************************************/
 Point::Point()
     : _x(0), _y(0), _z(0)
@@ -56,73 +75,79 @@ Point::normalize(double max)
 }
 
 /*****************************************************************************/
-Triangle::Triangle()
-{
-    bzero(_pts, 3*sizeof(size_t));
-}
-
-Triangle::Triangle(size_t p0, size_t p1, size_t p2)
-{
-    _pts[0] = p0;
-    _pts[1] = p1;
-    _pts[2] = p2;
-    std::sort(_pts, _pts+3);
-}
+NetgenNeutralMesh::NetgenNeutralMesh()
+    : _cache_enabled(true), _load_total(0), _stream(nullptr),
+      _topology(new MeshTopology(_domains)),
+      _monitor(nullptr), _cancelled(false)
+{}
 
-std::vector<size_t>
-Triangle::points(void) const
-{
-    std::vector<size_t> ret;
-    ret.assign(_pts, _pts+3);
-    return ret;
-}
+NetgenNeutralMesh::~NetgenNeutralMesh()
+{}
 
 bool
-Triangle::operator<(const Triangle& other) const
+NetgenNeutralMesh::report_progress(size_t done)
 {
-    return std::lexicographical_compare(_pts, _pts+3, other._pts, other._pts+3);
-}
-
-
-/*****************************************************************************/
-Tetrahedron::Tetrahedron()
-{
-    bzero(_pts, 4*sizeof(size_t));
+    if (_cancelled)
+        return false;
+    
+    /* Positions in decompressed data say nothing about the file size */
+    if (_stream)
+        done = _stream->consumed();
+    
+    if ( _monitor && !_monitor->progress(done, _load_total) )
+        _cancelled = true;
+    
+    return !_cancelled;
 }
 
-Tetrahedron::Tetrahedron(size_t p0, size_t p1, size_t p2, size_t p3)
+/* Elements store point indices as Triangle::index_type */
+bool
+NetgenNeutralMesh::check_point_count(size_t count)
 {
-    _pts[0] = p0;
-    _pts[1] = p1;
-    _pts[2] = p2;
-    _pts[3] = p3;
-    std::sort(_pts, _pts+4);
+    if ( count > size_t(std::numeric_limits<Triangle::index_type>::max()) )
+    {
+        std::cout << "Meshes with " << count << " points are not supported"
+                  << std::endl;
+        return false;
+    }
+    
+    return true;
 }
 
-std::vector<size_t>
-Tetrahedron::points(void) const
+template<typename T>
+static bool
+elements_in_range(ZoneTable<T>& zones, size_t count)
 {
-    std::vector<size_t> ret;
-    ret.assign(_pts, _pts+4);
-    return ret;
+    const T *elements = zones.elements();
+    
+    for (size_t i = 0; i < zones.elementCount(); i++)
+        for (auto p : elements[i].points())
+            if (p >= count)
+                return false;
+    
+    return true;
 }
 
 bool
-Tetrahedron::operator<(const Tetrahedron& other) const
+NetgenNeutralMesh::check_elements(bool verbose)
 {
-    return std::lexicographical_compare(_pts, _pts+4, other._pts, other._pts+4);
+    if ( elements_in_range(_domains, _points.size()) &&
+         elements_in_range(_boundaries, _points.size()) )
+        return true;
+    
+    if (verbose)
+        std::cout << "Elements of " << _filename << " refer to points "
+                  << "beyond the " << _points.size() << " it has"
+                  << std::endl;
+    
+    return false;
 }
 
-/*****************************************************************************/
-NetgenNeutralMesh::NetgenNeutralMesh()
-{}
-
 bool
-NetgenNeutralMesh::read_points(bool verbose)
+NetgenNeutralMesh::read_points(TextScanner& scanner, bool verbose)
 {
     size_t      n_items;
-    double      x, y, z, max_dim;
-    bool        first = true;
+    double      x, y, z;
     
     
     if (verbose)
@@ -131,63 +156,61 @@ NetgenNeutralMesh::read_points(bool verbose)
         std::cout.flush();
     }
     
-    _filestream >> n_items;
+    if ( !scanner.read_size(n_items) || !check_point_count(n_items) )
+        return false;
+    
     _points.reserve(n_items);
     
     while (n_items--)
     {
-        _filestream >> x >> y >> z;
+        if ( (n_items % PROGRESS_RECORDS) == 0 &&
+             !report_progress(scanner.offset()) )
+            return false;
         
-        if (first)
-        {
-            _min_x = _max_x = x;
-            _min_y = _max_y = y;
-            _min_z = _max_z = z;
-            first = false;
-        }
+        if ( !scanner.read_double(x) ||
+             !scanner.read_double(y) ||
+             !scanner.read_double(z) )
+            return false;
         
-        if ( x < _min_x )
-            _min_x = x;
-        if ( y < _min_y )
-            _min_y = y;
-        if ( z < _min_z )
-            _min_z = z;
-        
-        if ( x > _max_x )
-            _max_x = x;
-        if ( y > _max_y )
-            _max_y = y;
-        if ( z > _max_z )
-            _max_z = z;
-        
-        _points.push_back( Point(x,y,z) );
+        _points.push_back(x, y, z);
     }
     
     if(verbose)
         std::cout << "done" << std::endl;
     
-    max_dim = MAX(_max_x - _min_x, MAX(_max_y - _min_y, _max_z - _min_z) );
-    
+    return true;
+}
 
-    double mid_x = (_max_x + _min_x)/2;
-    double mid_y = (_max_y + _min_y)/2;
-    double mid_z = (_max_z + _min_z)/2;
+/* Computes the bounding box of the points as read, then centers them in
+ * the origin and scales them to unit size. */
+void
+NetgenNeutralMesh::normalize_points(void)
+{
+    double min[3], max[3];
     
-    for (size_t i = 0; i < _points.size(); i++)
-    {
-        Point p = _points.at(i);
-        _points.at(i) = Point( (p.x() - mid_x)/max_dim,
-                               (p.y() - mid_y)/max_dim,
-                               (p.z() - mid_z)/max_dim);
-    }
+    if ( _points.empty() )
+        return;
     
-    return true;
+    _points.bounds(0, _points.size(), min, max);
+    
+    _min_x = min[0]; _max_x = max[0];
+    _min_y = min[1]; _max_y = max[1];
+    _min_z = min[2]; _max_z = max[2];
+    
+    double max_dim = MAX(_max_x - _min_x, MAX(_max_y - _min_y, _max_z - _min_z) );
+    
+    double mid[3];
+    mid[0] = (_max_x + _min_x)/2;
+    mid[1] = (_max_y + _min_y)/2;
+    mid[2] = (_max_z + _min_z)/2;
+    
+    _points.normalize(mid, max_dim);
 }
 
 bool
-NetgenNeutralMesh::read_tets(bool verbose)
+NetgenNeutralMesh::read_tets(TextScanner& scanner, bool verbose)
 {
-    size_t n_items;
+    size_t n_items, npoints = _points.size();
     size_t p0, p1, p2, p3, dom;
     
     if (verbose)
@@ -196,14 +219,37 @@ NetgenNeutralMesh::read_tets(bool verbose)
         std::cout.flush();
     }
     
-    _filestream >> n_items;
+    if ( !scanner.read_size(n_items) )
+        return false;
+    
+    ZoneList<Tetrahedron> tets;
+    tets.reserve(n_items);
     
     while (n_items--)
     {
-        _filestream >> dom >> p0 >> p1 >> p2 >> p3;
-        _domains[dom].add(Tetrahedron(p0-1, p1-1, p2-1, p3-1));
+        if ( (n_items % PROGRESS_RECORDS) == 0 &&
+             !report_progress(scanner.offset()) )
+            return false;
+        
+        if ( !scanner.read_size(dom) ||
+             !scanner.read_size(p0) || !scanner.read_size(p1) ||
+             !scanner.read_size(p2) || !scanner.read_size(p3) )
+            return false;
+        
+        if ( !point_in_range(p0, npoints) || !point_in_range(p1, npoints) ||
+             !point_in_range(p2, npoints) || !point_in_range(p3, npoints) )
+        {
+            std::cout << "Tetrahedron with a point number out of 1-"
+                      << npoints << std::endl;
+            return false;
+        }
+        
+        tets.add(dom, Tetrahedron(p0-1, p1-1, p2-1, p3-1));
     }
     
+    if ( !_domains.assign(tets) )
+        return false;
+    
     if(verbose)
         std::cout << "done" << std::endl;
     
@@ -211,9 +257,9 @@ NetgenNeutralMesh::read_tets(bool verbose)
 }
 
 bool
-NetgenNeutralMesh::read_bndtris(bool verbose)
+NetgenNeutralMesh::read_bndtris(TextScanner& scanner, bool verbose)
 {
-    size_t n_items;
+    size_t n_items, npoints = _points.size();
     size_t p0, p1, p2, surf;
     
     if (verbose)
@@ -222,57 +268,420 @@ NetgenNeutralMesh::read_bndtris(bool verbose)
         std::cout.flush();
     }
     
-    _filestream >> n_items;
+    if ( !scanner.read_size(n_items) )
+        return false;
+    
+    ZoneList<Triangle> tris;
+    tris.reserve(n_items);
+    
+    /* Runs of triangles go to the monitor as they are parsed */
+    size_t shown = 0;
+    auto show = [&](void) {
+        if (_monitor && tris.size() > shown)
+            _monitor->trianglesLoaded(tris.elements.data() + shown,
+                                      tris.size() - shown);
+        shown = tris.size();
+    };
     
     while (n_items--)
     {
-        _filestream >> surf >> p0 >> p1 >> p2;
-        _boundaries[surf].add(Triangle(p0-1, p1-1, p2-1));
+        if ( (n_items % PROGRESS_RECORDS) == 0 )
+        {
+            if ( !report_progress(scanner.offset()) )
+                return false;
+            show();
+        }
+        
+        if ( !scanner.read_size(surf) || !scanner.read_size(p0) ||
+             !scanner.read_size(p1) || !scanner.read_size(p2) )
+            return false;
+        
+        if ( !point_in_range(p0, npoints) || !point_in_range(p1, npoints) ||
+             !point_in_range(p2, npoints) )
+        {
+            std::cout << "Boundary triangle with a point number out of 1-"
+                      << npoints << std::endl;
+            return false;
+        }
+        
+        tris.add(surf, Triangle(p0-1, p1-1, p2-1));
     }
     
+    show();
+    
+    if ( !_boundaries.assign(tris) )
+        return false;
+    
     if(verbose)
         std::cout << "done" << std::endl;
     
     return true;
 }
 
+/*****************************************************************************/
+/* Parallel loading. A quick sequential pass with memchr() finds the three
+ * sections and the start of every CHUNK_RECORDS-th line in them, then the
+ * chunks are parsed independently. Chunk results are merged in file order
+ * so the resulting mesh is identical to the one read_points(), read_tets()
+ * and read_bndtris() would build.
+ *
+ * Progress covers the pre-scan, then the parsing; the pre-scan and the
+ * merge of the chunks also stop early if the load is cancelled.
+ *
+ * The pre-scan assumes one record per line, as netgen writes them. Each
+ * chunk is parsed with a scanner bounded to its own lines, so input that
+ * breaks that assumption makes load_parallel() fail and load() falls back
+ * to the sequential reader.
+ */
+namespace {
+
+struct Section
+{
+    size_t                      count;
+    std::vector<const char *>   chunks;     /* chunk starts, then the end */
+};
+
+bool
+prescan_section(TextScanner& scanner, const char *end, Section& sec,
+                const std::function<bool (const char *)>& progress)
+{
+    if ( !scanner.read_size(sec.count) )
+        return false;
+    
+    const char *pos = scanner.position();
+    const char *nl = (const char *)memchr(pos, '\n', end - pos);
+    pos = nl ? nl+1 : end;
+    
+    sec.chunks.clear();
+    for (size_t i = 0; i < sec.count; i++)
+    {
+        if (pos == end)
+            return false;
+        
+        if (i % CHUNK_RECORDS == 0)
+        {
+            if ( !progress(pos) )
+                return false;
+            sec.chunks.push_back(pos);
+        }
+        
+        nl = (const char *)memchr(pos, '\n', end - pos);
+        pos = nl ? nl+1 : end;
+    }
+    sec.chunks.push_back(pos);
+    
+    scanner.seek(pos);
+    return true;
+}
+
+} // namespace
+
+bool
+NetgenNeutralMesh::load_parallel(const char *begin, const char *end, bool verbose)
+{
+    Section pts, tets, tris;
+    TextScanner scanner(begin, end);
+    size_t prescan = (end - begin)/PRESCAN_SHARE;
+    
+    auto prescanned = [&](const char *pos) {
+        return report_progress( (pos - begin)/PRESCAN_SHARE );
+    };
+    
+    if ( !prescan_section(scanner, end, pts, prescanned) ||
+         !prescan_section(scanner, end, tets, prescanned) ||
+         !prescan_section(scanner, end, tris, prescanned) )
+        return false;
+    
+    if ( !check_point_count(pts.count) )
+        return false;
+    
+    if (verbose)
+    {
+        std::cout << "Loading mesh with " << worker_count() << " threads...";
+        std::cout.flush();
+    }
+    
+    std::atomic<size_t> parsed(0);
+    
+    /* Points go straight to their final position */
+    _points.resize(pts.count);
+    std::vector<char> pt_ok(pts.chunks.size()-1, 0);
+    
+    parallel_for(pt_ok.size(), [&](size_t c) {
+        if (_cancelled)
+            return;
+        
+        TextScanner sc(pts.chunks[c], pts.chunks[c+1]);
+        size_t first = c*CHUNK_RECORDS;
+        size_t last = MIN(pts.count, first + CHUNK_RECORDS);
+        double x, y, z;
+        
+        for (size_t i = first; i < last; i++)
+        {
+            if ( !sc.read_double(x) || !sc.read_double(y) || !sc.read_double(z) )
+                return;
+            
+            _points.set(i, x, y, z);
+        }
+        
+        pt_ok[c] = sc.eof();
+        report_progress( prescan + (parsed += pts.chunks[c+1] - pts.chunks[c])
+                                  *(PRESCAN_SHARE-1)/PRESCAN_SHARE );
+    });
+    
+    for (auto ok : pt_ok)
+        if (!ok)
+            return false;
+    
+    normalize_points();
+    
+    if (_monitor)
+        _monitor->pointsLoaded(_points);
+    
+    /* The boundary triangles are the last section of the file, but they
+     * are parsed before the tetrahedrons: they are what a progressive
+     * view of the mesh draws first. */
+    std::vector<ZoneList<Triangle>> tri_lists(tris.chunks.size()-1);
+    std::vector<char> tri_ok(tri_lists.size(), 0);
+    
+    parallel_for(tri_lists.size(), [&](size_t c) {
+        if (_cancelled)
+            return;
+        
+        TextScanner sc(tris.chunks[c], tris.chunks[c+1]);
+        ZoneList<Triangle>& zl = tri_lists[c];
+        size_t n = MIN(tris.count - c*CHUNK_RECORDS, size_t(CHUNK_RECORDS));
+        size_t p0, p1, p2, surf;
+        
+        zl.reserve(n);
+        
+        while (n--)
+        {
+            if ( !sc.read_size(surf) || !sc.read_size(p0) ||
+                 !sc.read_size(p1) || !sc.read_size(p2) )
+                return;
+            
+            /* The sequential retry tells what is wrong */
+            if ( !point_in_range(p0, pts.count) ||
+                 !point_in_range(p1, pts.count) ||
+                 !point_in_range(p2, pts.count) )
+                return;
+            
+            zl.add(surf, Triangle(p0-1, p1-1, p2-1));
+        }
+        
+        tri_ok[c] = sc.eof();
+        
+        if (tri_ok[c] && _monitor)
+            _monitor->trianglesLoaded(zl.elements.data(), zl.size());
+        
+        report_progress( prescan + (parsed += tris.chunks[c+1] - tris.chunks[c])
+                                  *(PRESCAN_SHARE-1)/PRESCAN_SHARE );
+    });
+    
+    for (auto ok : tri_ok)
+        if (!ok)
+            return false;
+    
+    std::vector<ZoneList<Tetrahedron>> tet_lists(tets.chunks.size()-1);
+    std::vector<char> tet_ok(tet_lists.size(), 0);
+    
+    parallel_for(tet_lists.size(), [&](size_t c) {
+        if (_cancelled)
+            return;
+        
+        TextScanner sc(tets.chunks[c], tets.chunks[c+1]);
+        ZoneList<Tetrahedron>& zl = tet_lists[c];
+        size_t n = MIN(tets.count - c*CHUNK_RECORDS, size_t(CHUNK_RECORDS));
+        size_t p0, p1, p2, p3, dom;
+        
+        zl.reserve(n);
+        
+        while (n--)
+        {
+            if ( !sc.read_size(dom) ||
+                 !sc.read_size(p0) || !sc.read_size(p1) ||
+                 !sc.read_size(p2) || !sc.read_size(p3) )
+                return;
+            
+            if ( !point_in_range(p0, pts.count) ||
+                 !point_in_range(p1, pts.count) ||
+                 !point_in_range(p2, pts.count) ||
+                 !point_in_range(p3, pts.count) )
+                return;
+            
+            zl.add(dom, Tetrahedron(p0-1, p1-1, p2-1, p3-1));
+        }
+        
+        tet_ok[c] = sc.eof();
+        report_progress( prescan + (parsed += tets.chunks[c+1] - tets.chunks[c])
+                                  *(PRESCAN_SHARE-1)/PRESCAN_SHARE );
+    });
+    
+    for (auto ok : tet_ok)
+        if (!ok)
+            return false;
+    
+    /* The chunks, in file order, sort into the same zones as the
+     * sequential reader produces */
+    size_t done = prescan + parsed*(PRESCAN_SHARE-1)/PRESCAN_SHARE;
+    
+    if ( !report_progress(done) || !_domains.assign(tet_lists) ||
+         !report_progress(done) || !_boundaries.assign(tri_lists) )
+        return false;
+    
+    if (verbose)
+        std::cout << "done" << std::endl;
+    
+    return true;
+}
+
+bool
+NetgenNeutralMesh::load_serial(TextScanner& scanner, bool verbose)
+{
+    bool ok = read_points(scanner, verbose);
+    
+    if (ok)
+    {
+        normalize_points();
+        
+        if (_monitor)
+            _monitor->pointsLoaded(_points);
+    }
+    
+    ok = ok && read_tets(scanner, verbose) && read_bndtris(scanner, verbose);
+    
+    if (!ok)
+    {
+        if (!_cancelled)
+            std::cout << "Parse error in " << _filename << " at byte "
+                      << scanner.offset() << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+bool
+NetgenNeutralMesh::parse(const char *begin, const char *end, bool verbose)
+{
+    if (size_t(end - begin) >= PARALLEL_MIN_BYTES && worker_count() > 1)
+    {
+        if ( load_parallel(begin, end, verbose) )
+            return true;
+        
+        if (_cancelled)
+            return false;
+        
+        if (verbose)
+            std::cout << "Parallel loading failed, retrying sequentially"
+                      << std::endl;
+        
+        _points.clear();
+        _boundaries.clear();
+        _domains.clear();
+        
+        if (_monitor)
+            _monitor->loadRestarted();
+    }
+    
+    TextScanner scanner(begin, end);
+    return load_serial(scanner, verbose);
+}
+
+bool
+NetgenNeutralMesh::parse_stream(ByteStream& stream, bool verbose)
+{
+    TextScanner scanner(stream);
+    return load_serial(scanner, verbose);
+}
+
 bool
 NetgenNeutralMesh::load(const std::string& filename, bool verbose)
 {
+    _topology->clear();
     _points.clear();
     _boundaries.clear();
     _domains.clear();
     
-    _filestream.open(filename.c_str());
-    if ( !_filestream.is_open() )
+    _filename = filename;
+    _cancelled = false;
+    
+    /* The source is only mapped when there is no valid cache */
+    if ( _cache_enabled && read_cache(filename, verbose) )
     {
-        std::cout << "Cannot open " << filename << std::endl;
-        return false;
+        if (_monitor)
+        {
+            _monitor->pointsLoaded(_points);
+            for (auto& b : _boundaries)
+                _monitor->trianglesLoaded(b.data(), b.size());
+        }
+    }
+    else
+    {
+        MappedFile file;
+        if ( !file.open(filename) )
+        {
+            std::cout << "Cannot open " << filename << std::endl;
+            return false;
+        }
+        
+        _load_total = file.size();
+        
+        DecompressStream::Format format;
+        bool ok;
+        
+        format = DecompressStream::detect(file.begin(), file.size());
+        
+        if (format != DecompressStream::NONE)
+        {
+            DecompressStream ds;
+            
+            if (verbose)
+                std::cout << "Decompressing " << filename << std::endl;
+            
+            _stream = &ds;
+            ok = ds.start(format, file.begin(), file.size()) &&
+                 parse_stream(ds, verbose);
+            _stream = nullptr;
+            
+            /* A corrupt stream may end on a record boundary */
+            if ( ds.failed() )
+            {
+                std::cout << "Decompression of " << filename << " failed"
+                          << std::endl;
+                ok = false;
+            }
+        }
+        else
+            ok = parse(file.begin(), file.end(), verbose);
+        
+        if (!ok)
+        {
+            if (_cancelled && verbose)
+                std::cout << "Loading of " << filename << " cancelled" << std::endl;
+            return false;
+        }
+        
+        if (_cache_enabled)
+            write_cache(filename, verbose);
     }
     
-    _filename = filename;
-    _filestream.setf(std::ios_base::skipws);
-    
-    read_points(verbose);
-    read_tets(verbose);
-    read_bndtris(verbose);
+    report_progress(_load_total);
     
-
     if (verbose)
     {
         std::cout << "Points: " << _points.size() << std::endl;
         
         for (auto& me : _domains)
-            std::cout << "Domain " << me.first << ": " << me.second.size()
+            std::cout << "Domain " << me.id() << ": " << me.size()
                       << " tetrahedrons" << std::endl;
         
         for (auto& me : _boundaries)
-            std::cout << "Boundary " << me.first << ": " << me.second.size()
+            std::cout << "Boundary " << me.id() << ": " << me.size()
                       << " triangles" << std::endl;
     }
     
-    _filestream.close();
-    
     return true;
 }
 
@@ -280,56 +689,56 @@ void
 NetgenNeutralMesh::setHighlightBoundariesAll(void)
 {
     for (auto& b : _boundaries)
-        b.second.setHighlighted(true);
+        b.setHighlighted(true);
 }
 
 void
 NetgenNeutralMesh::setHighlightBoundariesNone(void)
 {
     for (auto& b : _boundaries)
-        b.second.setHighlighted(false);
+        b.setHighlighted(false);
 }
 
 void
 NetgenNeutralMesh::setHighlightDomainsAll(void)
 {
     for (auto& d : _domains)
-        d.second.setHighlighted(true);
+        d.setHighlighted(true);
 }
 
 void
 NetgenNeutralMesh::setHighlightDomainsNone(void)
 {
     for (auto& d : _domains)
-        d.second.setHighlighted(false);
+        d.setHighlighted(false);
 }
 
 void
 NetgenNeutralMesh::setDisplayBoundariesAll(void)
 {
     for (auto& b : _boundaries)
-        b.second.enableDisplay(true);
+        b.enableDisplay(true);
 }
 
 void
 NetgenNeutralMesh::setDisplayBoundariesNone(void)
 {
     for (auto& b : _boundaries)
-        b.second.enableDisplay(false);
+        b.enableDisplay(false);
 }
 
 void
 NetgenNeutralMesh::setDisplayDomainsAll(void)
 {
     for (auto& d : _domains)
-        d.second.enableDisplay(true);
+        d.enableDisplay(true);
 }
 
 void
 NetgenNeutralMesh::setDisplayDomainsNone(void)
 {
     for (auto& d : _domains)
-        d.second.enableDisplay(false);
+        d.enableDisplay(false);
 }
 
 
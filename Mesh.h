@@ -32,14 +32,24 @@
 #pragma once
 
 #include <vector>
+#include <array>
 #include <map>
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
-#include <set>
 #include <cmath>
 #include <iostream>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
 
 #include <QGLWidget>
 
+#include "TextScanner.h"
+#include "PointStore.h"
+#include "Parallel.h"
+#include "Edges.h"
+
 /*******************************************************************/
 class Point
 {
@@ -69,38 +79,118 @@ public:
 };
 
 /*******************************************************************/
-class Triangle
+/* Mesh elements keep their point indices sorted, in the narrowest type
+ * that can address all the points: the loaders refuse meshes with more
+ * points than Index can count. points() returns the indices by value,
+ * without allocating.
+ */
+template<typename Index = uint32_t>
+class BasicTriangle
 {
-    size_t  _pts[3];
+    Index   _pts[3];
     
 public:
-                            Triangle();
-                            Triangle(size_t, size_t, size_t);
-    std::vector<size_t>     points(void) const;
-    bool                    operator<(const Triangle&) const;
+    typedef Index   index_type;
+    
+                            BasicTriangle();
+                            BasicTriangle(size_t, size_t, size_t);
+    std::array<Index, 3>    points(void) const;
+    Index                   operator[](size_t i) const { return _pts[i]; }
+    bool                    operator<(const BasicTriangle&) const;
 };
 
 /*******************************************************************/
-class Tetrahedron
+template<typename Index = uint32_t>
+class BasicTetrahedron
 {
-    size_t  _pts[4];
+    Index   _pts[4];
     
 public:
-                            Tetrahedron();
-                            Tetrahedron(size_t, size_t, size_t, size_t);
-    std::vector<size_t>     points(void) const;
-    bool                    operator<(const Tetrahedron&) const;
+    typedef Index   index_type;
+    
+                            BasicTetrahedron();
+                            BasicTetrahedron(size_t, size_t, size_t, size_t);
+    std::array<Index, 4>    points(void) const;
+    Index                   operator[](size_t i) const { return _pts[i]; }
+    bool                    operator<(const BasicTetrahedron&) const;
     
 };
 
+typedef BasicTriangle<>         Triangle;
+typedef BasicTetrahedron<>      Tetrahedron;
+
+/*******************************************************************/
+template<typename Index>
+BasicTriangle<Index>::BasicTriangle()
+{
+    std::fill(_pts, _pts+3, 0);
+}
+
+template<typename Index>
+BasicTriangle<Index>::BasicTriangle(size_t p0, size_t p1, size_t p2)
+{
+    _pts[0] = p0;
+    _pts[1] = p1;
+    _pts[2] = p2;
+    std::sort(_pts, _pts+3);
+}
+
+template<typename Index>
+std::array<Index, 3>
+BasicTriangle<Index>::points(void) const
+{
+    return std::array<Index, 3>{{ _pts[0], _pts[1], _pts[2] }};
+}
+
+template<typename Index>
+bool
+BasicTriangle<Index>::operator<(const BasicTriangle& other) const
+{
+    return std::lexicographical_compare(_pts, _pts+3, other._pts, other._pts+3);
+}
+
 /*******************************************************************/
+template<typename Index>
+BasicTetrahedron<Index>::BasicTetrahedron()
+{
+    std::fill(_pts, _pts+4, 0);
+}
+
+template<typename Index>
+BasicTetrahedron<Index>::BasicTetrahedron(size_t p0, size_t p1, size_t p2, size_t p3)
+{
+    _pts[0] = p0;
+    _pts[1] = p1;
+    _pts[2] = p2;
+    _pts[3] = p3;
+    std::sort(_pts, _pts+4);
+}
+
+template<typename Index>
+std::array<Index, 4>
+BasicTetrahedron<Index>::points(void) const
+{
+    return std::array<Index, 4>{{ _pts[0], _pts[1], _pts[2], _pts[3] }};
+}
+
+template<typename Index>
+bool
+BasicTetrahedron<Index>::operator<(const BasicTetrahedron& other) const
+{
+    return std::lexicographical_compare(_pts, _pts+4, other._pts, other._pts+4);
+}
+
+/*******************************************************************/
+/* A zone is a contiguous slice of the connectivity array of the
+ * ZoneTable it belongs to, plus its display properties. */
 template<typename T>
 class MeshZone
 {
-    std::vector<T>          _objects;
+    size_t                  _id;
+    const T                 *_objects;
+    size_t                  _count;
     bool                    _display_enabled;
     bool                    _highlighted;
-    GLuint                  _list;
     GLfloat                 _red, _green, _blue, _alpha;
     
     std::string             _groupname;
@@ -108,57 +198,28 @@ class MeshZone
     double                  _minEdgeLength, _maxEdgeLength, _avgEdgeLength;
     bool                    _lengthsValid;
     
-    void calculateLengths(const std::vector<Point>& _points)
+    void calculateLengths(const PointStore& _points)
     {
-        bool first = true;
-        
-        std::set<std::pair<size_t, size_t>> _edges;
+        std::vector<uint64_t> edges = unique_edges(_objects, _count);
+        EdgeLengths lengths = edge_lengths(_points, edges);
         
-        for(auto& o : _objects)
-        {
-            auto pts = o.points();
-            
-            for (size_t i = 0; i < pts.size(); i++)
-                for (size_t j = i+1; j < pts.size(); j++)
-                    _edges.insert( std::make_pair(pts.at(i), pts.at(j)) );
-        }
-        
-        for (auto& e : _edges)
-        {
-            double d = _points.at(e.first).distanceFrom(_points.at(e.second));
-            
-            if (first)
-            {
-                _minEdgeLength = d;
-                _maxEdgeLength = d;
-                _avgEdgeLength = d;
-                first = false;
-                continue;
-            }
-            
-            if ( d < _minEdgeLength )
-                _minEdgeLength = d;
-            
-            if ( _maxEdgeLength < d )
-                _maxEdgeLength = d;
-            
-            _avgEdgeLength += d;
-        }
-        
-        _avgEdgeLength /= _edges.size();
+        _minEdgeLength = lengths.min;
+        _maxEdgeLength = lengths.max;
+        _avgEdgeLength = lengths.avg;
         
         _lengthsValid = true;
     }
     
 public:
-    MeshZone() : _display_enabled(true),
+    MeshZone() : _id(0), _objects(nullptr), _count(0),
+                 _display_enabled(true),
                  _highlighted(false),
                  _red(1), _green(0), _blue(0),
                  _alpha(0),
                  _lengthsValid(false)
     {}
     
-    double minEdgeLength(const std::vector<Point>& _points)
+    double minEdgeLength(const PointStore& _points)
     {
         if (!_lengthsValid)
             calculateLengths(_points);
@@ -166,7 +227,7 @@ public:
         return _minEdgeLength;
     }
     
-    double maxEdgeLength(const std::vector<Point>& _points)
+    double maxEdgeLength(const PointStore& _points)
     {
         if (!_lengthsValid)
             calculateLengths(_points);
@@ -174,7 +235,7 @@ public:
         return _maxEdgeLength;
     }
     
-    double avgEdgeLength(const std::vector<Point>& _points)
+    double avgEdgeLength(const PointStore& _points)
     {
         if (!_lengthsValid)
             calculateLengths(_points);
@@ -183,25 +244,33 @@ public:
     }
     
     void
-    add(const T& obj) { _objects.push_back(obj); }
+    setSlice(size_t id, const T *objects, size_t count)
+    {
+        _id = id;
+        _objects = objects;
+        _count = count;
+    }
     
     size_t
-    size(void) { return _objects.size(); }
+    id(void) const { return _id; }
     
-    bool
-    displayEnabled(void) { return _display_enabled; }
+    size_t
+    size(void) const { return _count; }
     
-    void
-    enableDisplay(bool en) { _display_enabled = en; }
+    const T *
+    data(void) const { return _objects; }
     
-    std::vector<T>&
-    objects(void) { return _objects; }
+    const T *
+    begin(void) const { return _objects; }
     
-    GLuint
-    list(void) { return _list; }
+    const T *
+    end(void) const { return _objects + _count; }
+    
+    bool
+    displayEnabled(void) { return _display_enabled; }
     
     void
-    setList(GLuint list) { _list = list; }
+    enableDisplay(bool en) { _display_enabled = en; }
     
     void
     setHighlighted(bool en) { _highlighted = en; }
@@ -248,6 +317,278 @@ public:
 typedef MeshZone<Triangle>      Boundary;
 typedef MeshZone<Tetrahedron>   Domain;
 
+/* Zone ids above this are refused, the id to slot index is dense */
+#define MAX_ZONE_ID     (1 << 24)
+
+/*******************************************************************/
+/* Elements in the order they were read, each with its zone id */
+template<typename T>
+struct ZoneList
+{
+    std::vector<T>          elements;
+    std::vector<size_t>     zones;
+    
+    void
+    reserve(size_t n)
+    {
+        elements.reserve(n);
+        zones.reserve(n);
+    }
+    
+    void
+    add(size_t zone, const T& elem)
+    {
+        elements.push_back(elem);
+        zones.push_back(zone);
+    }
+    
+    size_t
+    size(void) const { return elements.size(); }
+};
+
+/*******************************************************************/
+/* All the zones of one kind, in compressed sparse row form: a single
+ * connectivity array sorted by zone id, the offset of every zone in it
+ * and a dense zone id to slot index. Zones are kept in increasing id
+ * order; within a zone the elements keep the order they were read in.
+ */
+template<typename T>
+class ZoneTable
+{
+    static const uint32_t   NO_SLOT = uint32_t(-1);
+    
+    std::vector<T>              _elements;
+    std::vector<size_t>         _offsets;
+    std::vector<MeshZone<T>>    _zones;
+    std::vector<uint32_t>       _slots;
+    
+    bool    index_ids(const std::vector<size_t>&);
+    void    make_views(void);
+    bool    sort_lists(const ZoneList<T> *, size_t);
+    
+public:
+    typedef typename std::vector<MeshZone<T>>::iterator     iterator;
+    
+    ZoneTable() {}
+    ZoneTable(const ZoneTable&) = delete;
+    ZoneTable& operator=(const ZoneTable&) = delete;
+    
+    /* Counting sort of the lists, concatenated in order, into the
+     * table. The lists are sorted in parallel. */
+    bool    assign(const std::vector<ZoneList<T>>&);
+    bool    assign(const ZoneList<T>&);
+    
+    /* Lays out zones with the given increasing ids and sizes; the
+     * caller then fills elements() */
+    bool    assign(const std::vector<size_t>& ids, const std::vector<size_t>& counts);
+    
+    void    clear(void);
+    
+    size_t  size(void) const { return _zones.size(); }
+    bool    empty(void) const { return _zones.empty(); }
+    
+    size_t  elementCount(void) const { return _elements.size(); }
+    T *     elements(void) { return _elements.data(); }
+    
+    /* Position of the first element of a zone in elements() */
+    size_t  offset(size_t slot) const { return _offsets[slot]; }
+    
+    /* Zone by slot, 0 to size()-1 */
+    MeshZone<T>&    zone(size_t slot) { return _zones[slot]; }
+    
+    /* Slot of the zone holding the element at the given position of
+     * elements() */
+    size_t
+    slotOf(size_t element) const
+    {
+        return std::upper_bound(_offsets.begin(), _offsets.end(), element) -
+               _offsets.begin() - 1;
+    }
+    
+    bool
+    contains(size_t id) const
+    {
+        return id < _slots.size() && _slots[id] != NO_SLOT;
+    }
+    
+    /* Zone by id; throws std::out_of_range if there is no such zone */
+    MeshZone<T>&
+    at(size_t id)
+    {
+        if ( !contains(id) )
+            throw std::out_of_range("ZoneTable::at");
+        
+        return _zones[ _slots[id] ];
+    }
+    
+    iterator    begin(void) { return _zones.begin(); }
+    iterator    end(void) { return _zones.end(); }
+};
+
+template<typename T>
+const uint32_t ZoneTable<T>::NO_SLOT;
+
+template<typename T>
+void
+ZoneTable<T>::clear(void)
+{
+    _elements.clear();
+    _elements.shrink_to_fit();
+    _offsets.clear();
+    _zones.clear();
+    _slots.clear();
+}
+
+/* Builds the slot index and the empty zones for the ids given */
+template<typename T>
+bool
+ZoneTable<T>::index_ids(const std::vector<size_t>& ids)
+{
+    size_t max_id = 0;
+    for (auto id : ids)
+        max_id = std::max(max_id, id);
+    
+    if ( !ids.empty() && max_id > MAX_ZONE_ID )
+    {
+        std::cout << "Zone id " << max_id << " is too large" << std::endl;
+        return false;
+    }
+    
+    _slots.assign(ids.empty() ? 0 : max_id+1, NO_SLOT);
+    _zones.resize(ids.size());
+    
+    for (size_t s = 0; s < ids.size(); s++)
+    {
+        _slots[ids[s]] = s;
+        _zones[s].setSlice(ids[s], nullptr, 0);
+    }
+    
+    return true;
+}
+
+template<typename T>
+void
+ZoneTable<T>::make_views(void)
+{
+    for (size_t s = 0; s < _zones.size(); s++)
+        _zones[s].setSlice(_zones[s].id(), _elements.data() + _offsets[s],
+                           _offsets[s+1] - _offsets[s]);
+}
+
+template<typename T>
+bool
+ZoneTable<T>::assign(const std::vector<size_t>& ids, const std::vector<size_t>& counts)
+{
+    clear();
+    
+    for (size_t s = 1; s < ids.size(); s++)
+        if ( ids[s] <= ids[s-1] )
+            return false;
+    
+    if ( ids.size() != counts.size() || !index_ids(ids) )
+        return false;
+    
+    _offsets.resize(ids.size()+1);
+    _offsets[0] = 0;
+    for (size_t s = 0; s < ids.size(); s++)
+        _offsets[s+1] = _offsets[s] + counts[s];
+    
+    _elements.resize(_offsets.back());
+    make_views();
+    
+    return true;
+}
+
+template<typename T>
+bool
+ZoneTable<T>::assign(const ZoneList<T>& list)
+{
+    return sort_lists(&list, 1);
+}
+
+template<typename T>
+bool
+ZoneTable<T>::assign(const std::vector<ZoneList<T>>& lists)
+{
+    return sort_lists(lists.data(), lists.size());
+}
+
+template<typename T>
+bool
+ZoneTable<T>::sort_lists(const ZoneList<T> *lists, size_t nlists)
+{
+    clear();
+    
+    /* The ids present, in increasing order */
+    size_t max_id = 0;
+    for (size_t l = 0; l < nlists; l++)
+        for (auto id : lists[l].zones)
+            max_id = std::max(max_id, id);
+    
+    if (max_id > MAX_ZONE_ID)
+    {
+        std::cout << "Zone id " << max_id << " is too large" << std::endl;
+        return false;
+    }
+    
+    std::vector<char> present(max_id+1, 0);
+    for (size_t l = 0; l < nlists; l++)
+        for (auto id : lists[l].zones)
+            present[id] = 1;
+    
+    std::vector<size_t> ids;
+    for (size_t id = 0; id <= max_id; id++)
+        if ( present[id] )
+            ids.push_back(id);
+    
+    if ( !index_ids(ids) )
+        return false;
+    
+    /* Per list histograms allow to scatter the lists in parallel, but
+     * with many zones they cost more than they save */
+    size_t nslots = ids.size();
+    size_t nhist = (nlists*nslots <= (1 << 22)) ? nlists : 1;
+    std::vector<size_t> pos(nhist*nslots, 0);
+    
+    auto histogram = [&](size_t h) {
+        for (size_t l = h; l < nlists; l += nhist)
+            for (auto id : lists[l].zones)
+                pos[h*nslots + _slots[id]]++;
+    };
+    parallel_for(nhist, histogram);
+    
+    /* Turn the counts into the first position of each list in each zone */
+    _offsets.resize(nslots+1);
+    size_t total = 0;
+    for (size_t s = 0; s < nslots; s++)
+    {
+        _offsets[s] = total;
+        for (size_t h = 0; h < nhist; h++)
+        {
+            size_t count = pos[h*nslots + s];
+            pos[h*nslots + s] = total;
+            total += count;
+        }
+    }
+    _offsets[nslots] = total;
+    
+    _elements.resize(total);
+    
+    auto scatter = [&](size_t h) {
+        for (size_t l = h; l < nlists; l += nhist)
+            for (size_t i = 0; i < lists[l].size(); i++)
+            {
+                size_t& p = pos[h*nslots + _slots[ lists[l].zones[i] ]];
+                _elements[p++] = lists[l].elements[i];
+            }
+    };
+    parallel_for(nhist, scatter);
+    
+    make_views();
+    
+    return true;
+}
+
 class GroupProperties
 {
     GLfloat _red, _green, _blue;
@@ -269,32 +610,107 @@ public:
     
 };
 
+class DecompressStream;
+class MeshTopology;
+
+/*******************************************************************/
+/* Gets notified while NetgenNeutralMesh::load() runs. The methods can
+ * be called from the loader's worker threads, concurrently.
+ */
+class LoadMonitor
+{
+public:
+    virtual ~LoadMonitor() {}
+    
+    /* Bytes of the input processed so far. Returning false cancels the
+     * load, which then fails. */
+    virtual bool progress(size_t, size_t) { return true; }
+    
+    /* The normalized points, as soon as they are all known */
+    virtual void pointsLoaded(const PointStore&) {}
+    
+    /* A run of boundary triangles, indexing the points above. Called
+     * repeatedly while the boundaries are parsed. */
+    virtual void trianglesLoaded(const Triangle *, size_t) {}
+    
+    /* What was delivered so far is void: the load starts over */
+    virtual void loadRestarted(void) {}
+};
+
 /*******************************************************************/
 class NetgenNeutralMesh
 {
     std::string                     _filename;
-    std::ifstream                   _filestream;
-
-    std::vector<Point>              _points;
-    std::map<size_t, Boundary>      _boundaries;
-    std::map<size_t, Domain>        _domains;
     
     std::map<std::string, GroupProperties>  _elemGroupProps;
     
+    bool    _cache_enabled;
+    size_t  _load_total;
+    
+    DecompressStream                *_stream;
+    
+    std::unique_ptr<MeshTopology>   _topology;
+    
+    bool    read_tets(TextScanner&, bool);
+    bool    read_bndtris(TextScanner&, bool);
+    
+    bool    load_serial(TextScanner&, bool);
+    bool    load_parallel(const char *, const char *, bool);
+    
+    bool    read_cache(const std::string&, bool);
+    bool    write_cache(const std::string&, bool);
+    
+protected:
+    PointStore                      _points;
+    ZoneTable<Triangle>             _boundaries;
+    ZoneTable<Tetrahedron>          _domains;
+    
     double _min_x, _min_y, _min_z, _max_x, _max_y, _max_z;
     
-    bool    read_points(bool);
-    bool    read_tets(bool);
-    bool    read_bndtris(bool);
+    LoadMonitor                     *_monitor;
+    std::atomic<bool>               _cancelled;
+    
+    bool    report_progress(size_t);
+    
+    bool    check_point_count(size_t);
+    bool    read_points(TextScanner&, bool);
+    
+    /* Point numbers in files start from 1, 0 wraps around */
+    static bool
+    point_in_range(size_t number, size_t count) { return number-1 < count; }
+    
+    /* Elements index the point arrays unchecked everywhere else: false,
+     * with an error, if any of them refers to a point that is not there */
+    bool    check_elements(bool);
+    void    normalize_points(void);
+    
+    /* Fill points, domains and boundaries from the file contents. The
+     * points must be normalized by the time it returns. Readers for
+     * other file formats override this. */
+    virtual bool    parse(const char *, const char *, bool);
+    
+    /* Same, for compressed files: the contents arrive through a stream
+     * while they are being decompressed. */
+    virtual bool    parse_stream(ByteStream&, bool);
     
 public:
     NetgenNeutralMesh();
+    virtual ~NetgenNeutralMesh();
 
     bool    load(const std::string&, bool verbose = false);
     
-    std::vector<Point>&             points(void) { return _points; }
-    std::map<size_t, Boundary>&     boundaries(void) { return _boundaries; }
-    std::map<size_t, Domain>&       domains(void) { return _domains; }
+    /* Use and refresh the binary sidecar (see MeshCache.h), on by default */
+    void    setCacheEnabled(bool en) { _cache_enabled = en; }
+    
+    void    setLoadMonitor(LoadMonitor *monitor) { _monitor = monitor; }
+    bool    cancelled(void) const { return _cancelled; }
+    
+    PointStore&                     points(void) { return _points; }
+    ZoneTable<Triangle>&            boundaries(void) { return _boundaries; }
+    ZoneTable<Tetrahedron>&         domains(void) { return _domains; }
+    
+    /* Edges, faces and adjacency of the domains, see Topology.h */
+    MeshTopology&                   topology(void) { return *_topology; }
     
     std::map<std::string, GroupProperties>& groupProps(void)
     {
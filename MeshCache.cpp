@@ -0,0 +1,257 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "MappedFile.h"
+
+static_assert(sizeof(Tetrahedron) == 4*sizeof(uint32_t), "Tetrahedron layout");
+static_assert(sizeof(Triangle) == 3*sizeof(uint32_t), "Triangle layout");
+
+/*****************************************************************************/
+static bool
+source_stat(const std::string& filename, MeshCacheHeader& hdr)
+{
+    struct stat st;
+    
+    if ( stat(filename.c_str(), &st) != 0 )
+        return false;
+    
+    hdr.source_size = st.st_size;
+    hdr.source_mtime = st.st_mtime;
+#ifdef __APPLE__
+    hdr.source_mtime_nsec = st.st_mtimespec.tv_nsec;
+#else
+    hdr.source_mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+/* The zone table and connectivity are the ZoneTable layout as is */
+template<typename T>
+static bool
+map_zones(const char *& pos, const char *end, uint64_t num_zones,
+          ZoneTable<T>& zones)
+{
+    const uint64_t *table = (const uint64_t *)pos;
+    
+    /* Counts are checked against what is left before anything is
+     * allocated or multiplied by them */
+    if ( num_zones > uint64_t(end - pos)/(2*sizeof(uint64_t)) )
+        return false;
+    
+    pos += num_zones*2*sizeof(uint64_t);
+    
+    uint64_t max_elements = uint64_t(end - pos)/sizeof(T);
+    uint64_t total = 0;
+    std::vector<size_t> ids(num_zones), counts(num_zones);
+    
+    for (uint64_t i = 0; i < num_zones; i++)
+    {
+        ids[i] = table[2*i];
+        counts[i] = table[2*i+1];
+        
+        if ( counts[i] > max_elements - total )
+            return false;
+        total += counts[i];
+    }
+    
+    if ( !zones.assign(ids, counts) )
+        return false;
+    
+    memcpy(zones.elements(), pos, zones.elementCount()*sizeof(T));
+    pos += zones.elementCount()*sizeof(T);
+    
+    return true;
+}
+
+bool
+NetgenNeutralMesh::read_cache(const std::string& filename, bool verbose)
+{
+    MeshCacheHeader source;
+    MappedFile      cache;
+    
+    if ( !source_stat(filename, source) )
+        return false;
+    
+    if ( !cache.open(mesh_cache_filename(filename)) )
+        return false;
+    
+    if ( cache.size() < sizeof(MeshCacheHeader) )
+        return false;
+    
+    MeshCacheHeader hdr;
+    memcpy(&hdr, cache.begin(), sizeof(hdr));
+    
+    if ( strncmp(hdr.magic, MESH_CACHE_MAGIC, sizeof(hdr.magic)) != 0 ||
+         hdr.version != MESH_CACHE_VERSION ||
+         hdr.byte_order != 0x01020304 )
+        return false;
+    
+    if (hdr.source_size != source.source_size ||
+        hdr.source_mtime != source.source_mtime ||
+        hdr.source_mtime_nsec != source.source_mtime_nsec)
+    {
+        if (verbose)
+            std::cout << "Mesh cache is stale, ignoring it" << std::endl;
+        return false;
+    }
+    
+    const char *pos = cache.begin() + sizeof(hdr);
+    const char *end = cache.end();
+    
+    if ( hdr.num_points > uint64_t(end - pos)/(3*sizeof(double)) )
+        return false;
+    
+    size_t coord_bytes = hdr.num_points*sizeof(double);
+    
+    _points.resize(hdr.num_points);
+    memcpy(_points.x(), pos, coord_bytes);
+    memcpy(_points.y(), pos + coord_bytes, coord_bytes);
+    memcpy(_points.z(), pos + 2*coord_bytes, coord_bytes);
+    pos += 3*coord_bytes;
+    
+    if ( !map_zones(pos, end, hdr.num_domains, _domains) ||
+         !map_zones(pos, end, hdr.num_boundaries, _boundaries) ||
+         !check_elements(false) )
+    {
+        _points.clear();
+        _domains.clear();
+        _boundaries.clear();
+        return false;
+    }
+    
+    _min_x = hdr.bbox[0]; _max_x = hdr.bbox[1];
+    _min_y = hdr.bbox[2]; _max_y = hdr.bbox[3];
+    _min_z = hdr.bbox[4]; _max_z = hdr.bbox[5];
+    
+    _points.updateRenderBuffer();
+    
+    /* Progress is in bytes of the source, which is not read at all */
+    _load_total = source.source_size;
+    
+    if (verbose)
+        std::cout << "Loaded from cache " << mesh_cache_filename(filename)
+                  << std::endl;
+    
+    return true;
+}
+
+template<typename T>
+static void
+write_zones(FILE *fp, ZoneTable<T>& zones)
+{
+    for (auto& z : zones)
+    {
+        uint64_t entry[2] = { z.id(), z.size() };
+        fwrite(entry, sizeof(entry), 1, fp);
+    }
+    
+    fwrite(zones.elements(), sizeof(T), zones.elementCount(), fp);
+}
+
+/* The cache is written to a temporary file of its own and renamed in
+ * place, so that neither a concurrent reader nor a concurrent writer
+ * ever sees a partial cache.
+ */
+bool
+NetgenNeutralMesh::write_cache(const std::string& filename, bool verbose)
+{
+    MeshCacheHeader hdr;
+    
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+    hdr.version = MESH_CACHE_VERSION;
+    hdr.byte_order = 0x01020304;
+    
+    if ( !source_stat(filename, hdr) )
+        return false;
+    
+    hdr.num_points = _points.size();
+    hdr.num_domains = _domains.size();
+    hdr.num_boundaries = _boundaries.size();
+    hdr.bbox[0] = _min_x; hdr.bbox[1] = _max_x;
+    hdr.bbox[2] = _min_y; hdr.bbox[3] = _max_y;
+    hdr.bbox[4] = _min_z; hdr.bbox[5] = _max_z;
+    
+    std::string cachename = mesh_cache_filename(filename);
+    std::vector<char> tmpname(cachename.begin(), cachename.end());
+    const char suffix[] = ".XXXXXX";
+    tmpname.insert(tmpname.end(), suffix, suffix + sizeof(suffix));
+    
+    int fd = mkstemp(tmpname.data());
+    FILE *fp = (fd < 0) ? nullptr : fdopen(fd, "wb");
+    if (!fp)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+            remove(tmpname.data());
+        }
+        if (verbose)
+            std::cout << "Cannot write mesh cache " << cachename << std::endl;
+        return false;
+    }
+    
+    /* mkstemp() makes the file private to the user */
+    fchmod(fd, 0644);
+    
+    fwrite(&hdr, sizeof(hdr), 1, fp);
+    fwrite(_points.x(), sizeof(double), _points.size(), fp);
+    fwrite(_points.y(), sizeof(double), _points.size(), fp);
+    fwrite(_points.z(), sizeof(double), _points.size(), fp);
+    write_zones(fp, _domains);
+    write_zones(fp, _boundaries);
+    
+    bool ok = !ferror(fp);
+    ok = (fclose(fp) == 0) && ok;
+    
+    if ( !ok || rename(tmpname.data(), cachename.c_str()) != 0 )
+    {
+        remove(tmpname.data());
+        if (verbose)
+            std::cout << "Cannot write mesh cache " << cachename << std::endl;
+        return false;
+    }
+    
+    if (verbose)
+        std::cout << "Wrote mesh cache " << cachename << std::endl;
+    
+    return true;
+}
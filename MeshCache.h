@@ -0,0 +1,77 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/*******************************************************************/
+/* Binary sidecar written next to a parsed mesh (mesh.vol.mvcache).
+ * The file is the header below followed by flat, 8-byte aligned
+ * arrays in native byte order:
+ *
+ *   points        num_points x, then y, then z doubles, normalized
+ *   domain table  num_domains * { uint64 id, uint64 count }
+ *   domain tets   sum(count) * 4 uint32 point indices
+ *   bnd table     num_boundaries * { uint64 id, uint64 count }
+ *   bnd tris      sum(count) * 3 uint32 point indices
+ *
+ * The cache is only used if the source file still has the size and
+ * modification time, to the nanosecond where the file system keeps
+ * it, recorded in the header; the counts in the header must also fit
+ * in the size of the cache. The arrays are copied into the mesh out of
+ * a mapping of the cache. Bump MESH_CACHE_VERSION whenever the layout
+ * changes.
+ */
+#define MESH_CACHE_MAGIC        "MVCACHE"
+#define MESH_CACHE_VERSION      4
+#define MESH_CACHE_SUFFIX       ".mvcache"
+
+struct MeshCacheHeader
+{
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    byte_order;         /* 0x01020304 as written */
+    uint64_t    source_size;
+    int64_t     source_mtime;
+    int64_t     source_mtime_nsec;
+    uint64_t    num_points;
+    uint64_t    num_domains;
+    uint64_t    num_boundaries;
+    double      bbox[6];            /* min x, max x, min y, ... */
+};
+
+inline std::string
+mesh_cache_filename(const std::string& source)
+{
+    return source + MESH_CACHE_SUFFIX;
+}
+
@@ -32,24 +32,128 @@
 #include <algorithm>
 
 #include "MeshGLWidget.h"
+#include "Topology.h"
+#include "Export.h"
 
 #define MIN(a,b) ((a < b) ? a : b)
 #define MAX(a,b) ((a < b) ? b : a)
 
+/* Time without camera moves before a full quality frame */
+#define REFINE_DELAY_MS             150
+
+/* Chunks smaller than this are not drawn while the camera moves */
+#define INTERACTION_CHUNK_PIXELS    4
+
+/* Time between two checks for the zones an export waits for */
+#define EXPORT_WAIT_MS              50
+
+/* Builds a batch of zones in the background and hands them over to the
+ * widget one at a time, stopping early if the mesh changed meanwhile */
+class ZoneCompiler : public QRunnable
+{
+    MeshGLWidget                            *_widget;
+    std::shared_ptr<NetgenNeutralMesh>      _nnm;
+    unsigned                                _generation;
+    std::vector<MeshRenderer::ZoneGeometry> _batch;
+    
+public:
+    ZoneCompiler(MeshGLWidget *widget, std::shared_ptr<NetgenNeutralMesh> nnm,
+                 unsigned generation,
+                 std::vector<MeshRenderer::ZoneGeometry>& batch)
+        : _widget(widget), _nnm(nnm), _generation(generation)
+    {
+        _batch.swap(batch);
+    }
+    
+    void
+    run(void)
+    {
+        /* All the missing shells in a single pass over the mesh faces */
+        std::vector<size_t> shells;
+        for (auto& g : _batch)
+            if (g.kind == MeshRenderer::KIND_SHELLS)
+                shells.push_back(g.slot);
+        
+        if ( !shells.empty() )
+            _nnm->topology().buildShells(shells);
+        
+        for (auto& g : _batch)
+        {
+            MeshRenderer::buildZone(*_nnm, g);
+            
+            if ( !_widget->zone_built(_generation, g) )
+                return;
+        }
+    }
+};
+
+/* Key of a zone in the set of the ones being compiled */
+static size_t
+zone_key(MeshRenderer::ZoneKind kind, size_t slot, bool edges, size_t level)
+{
+    return ((slot*MeshRenderer::KIND_COUNT + kind)*2 + edges)*LOD_LEVELS + level;
+}
+
+/* Buffer swaps wait for the vertical retrace. The renderer needs
+ * OpenGL 3.1 along with the fixed function matrices, which the default
+ * format does not ask for everywhere. */
+static QGLFormat
+frame_format(void)
+{
+    QGLFormat format = QGLFormat::defaultFormat();
+    format.setSwapInterval(1);
+    format.setVersion(3, 1);
+    format.setProfile(QGLFormat::CompatibilityProfile);
+    return format;
+}
+
 MeshGLWidget::MeshGLWidget(QWidget *parent)
-    : QGLWidget(parent),
-      _nnm(nullptr)
+    : QGLWidget(frame_format(), parent),
+      _nnm(nullptr),
+      _generation(0),
+      _interacting(false),
+      _frameBudget(FRAME_BUDGET_MS),
+      _fullFrameTime(0),
+      _exportFrame(0), _exportFrames(0),
+      _exportCancelled(false),
+      _fullDetail(false)
 {
     _rotX = _rotY = 0.0;
     _tranX = _tranY = 0.0;
     _prevX = _prevY = 0;
     
     _zoom = 1.0;
-    _zoom_max = 3.0;
+    _zoom_max = VIEW_ZOOM_MAX;
     
     resize(700,700);
     
     whatToDraw = DRAW_TETRAHEDRONS;
+    _wireframe = true;
+    
+    /* One batch at a time; the zones use all the cores themselves */
+    _compilePool.setMaxThreadCount(1);
+    _lodPool.setMaxThreadCount(1);
+    
+    _refineTimer.setSingleShot(true);
+    _refineTimer.setInterval(REFINE_DELAY_MS);
+    connect(&_refineTimer, SIGNAL(timeout()), this, SLOT(refine()));
+    
+    connect(&_exportTimer, SIGNAL(timeout()), this, SLOT(exportStep()));
+}
+
+MeshGLWidget::~MeshGLWidget()
+{
+    {
+        std::lock_guard<std::mutex> lock(_compiledMutex);
+        _generation++;
+    }
+    _compilePool.waitForDone();
+    _lodPool.waitForDone();
+    
+    makeCurrent();
+    _exporter.reset();
+    _gpuTimer.release();
+    _renderer.release();
 }
 
 void
@@ -71,12 +175,23 @@ MeshGLWidget::initializeGL()
     
     //glEnable(GL_LINE_SMOOTH);
     //glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+    
+    const QGLContext *ctx = context();
+    if ( _renderer.initialize([ctx](const char *name) {
+            return ctx->getProcAddress(QString(name));
+         }) )
+        _gpuTimer.initialize( _renderer.functions() );
+    else
+        _glError = QString("Meshes cannot be drawn: OpenGL 3.1 is required, "
+                           "this context is OpenGL %1")
+                   .arg( (const char *)glGetString(GL_VERSION) );
 }
 
 void
 MeshGLWidget::resizeGL( int w, int h )
 {
     glViewport(0, 0, w, h);
+    report_quantization();
  
     /*
     glMatrixMode(GL_PROJECTION);
@@ -91,22 +206,53 @@ MeshGLWidget::resizeGL( int w, int h )
 void
 MeshGLWidget::paintGL()
 {
+    /* A full frame takes as long as the longer of the CPU and the GPU;
+     * the GPU time comes in a frame or more later */
+    if ( !_renderer.ready() )
+    {
+        glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+        glColor3f(1.0f, 0.3f, 0.3f);
+        renderText(10, 20, _glError);
+        return;
+    }
+    
+    double gpu;
+    if ( _gpuTimer.elapsed(gpu) )
+        _fullFrameTime = std::max(_fullFrameTime, gpu);
+    
+    size_t bias = reduction();
+    
+    if (!bias)
+    {
+        _frameTimer.start();
+        _gpuTimer.begin();
+    }
+    
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
     glLoadIdentity();
     
     draw_axes();
-    prepare_tritet_view();
-    switch (whatToDraw)
+    prepare_tritet_view(width()/(double)height());
+    
+    _renderer.setCulling(true, bias ? INTERACTION_CHUNK_PIXELS : 1);
+    _renderer.begin();
+    
+    if ( _renderer.hasPreview() )
+        draw_preview();
+    else if (bias)
+        draw_triangles(bias);
+    else
+        draw_scene();
+    
+    _renderer.end();
+    
+    if (!bias)
     {
-            
-        case DRAW_TRIANGLES:
-            draw_triangles();
-            break;
-            
-        case DRAW_TETRAHEDRONS:
-            draw_tetrahedrons();
-            break;
+        _gpuTimer.end();
+        _fullFrameTime = _frameTimer.nsecsElapsed()/1e6;
     }
+    
+    compile_requested();
 }
 
 void
@@ -144,10 +290,9 @@ MeshGLWidget::draw_axes()
 }
 
 void
-MeshGLWidget::prepare_tritet_view(void)
+MeshGLWidget::prepare_tritet_view(double aspect)
 {
-    double scalefact = 4.0/5.0;
-    double aspect = width()/(double)height();
+    double scalefact = VIEW_SCALE;
     
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
@@ -166,183 +311,281 @@ MeshGLWidget::prepare_tritet_view(void)
 }
 
 void
-MeshGLWidget::compile_triangles(void)
+MeshGLWidget::draw_scene(void)
 {
-    if (!_nnm)
-        return;
-    
-    for ( auto& b : _nnm->boundaries() )
+    switch (whatToDraw)
     {
-        GLuint list;
-        
-        list = glGenLists(1);
-        
-        glNewList(list, GL_COMPILE);
-        glBegin(GL_TRIANGLES);
-        
-        for (auto& t : b.second.objects())
-        {
-            auto pts = t.points();
-            glVertex3f(_nnm->points()[pts.at(0)].x(),
-                       _nnm->points()[pts.at(0)].y(),
-                       _nnm->points()[pts.at(0)].z());
+        case DRAW_TRIANGLES:
+            draw_triangles(0);
+            break;
             
-            glVertex3f(_nnm->points()[pts.at(1)].x(),
-                       _nnm->points()[pts.at(1)].y(),
-                       _nnm->points()[pts.at(1)].z());
-
-            glVertex3f(_nnm->points()[pts.at(2)].x(),
-                       _nnm->points()[pts.at(2)].y(),
-                       _nnm->points()[pts.at(2)].z());
+        case DRAW_TETRAHEDRONS:
+            draw_tetrahedrons();
+            break;
             
-        }
-        
-        glEnd();
-        glEndList();
-        
-        b.second.setList(list);
+        case DRAW_SHELLS:
+            draw_shells();
+            break;
     }
 }
 
+/* Boundaries, bias levels of detail coarser than the view needs */
 void
-MeshGLWidget::draw_triangles(void)
+MeshGLWidget::draw_triangles(size_t bias)
 {
     if (!_nnm)
         return;
     
     glLineWidth(1);
     
-    for ( auto& b : _nnm->boundaries() )
+    std::vector<MeshRenderer::ZoneDraw> draws;
+    
+    for (size_t slot = 0; slot < _nnm->boundaries().size(); slot++)
     {
+        Boundary& b = _nnm->boundaries().zone(slot);
+        size_t level = 0;
         
-        if ( !b.second.displayEnabled() )
-            continue;
-        
-        //glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        
-        glColor4f(1.0f, 0.0f, 0.0f, 0.5f);
+        if (!_fullDetail)
+        {
+            level = _renderer.pickLevel(MeshRenderer::KIND_BOUNDARIES,
+                                        slot, _wireframe);
+            level = std::min<size_t>(level + bias, LOD_LEVELS-1);
+        }
         
+        if ( !b.displayEnabled() ||
+             !zone_ready(MeshRenderer::KIND_BOUNDARIES, slot, level) )
+            continue;
         
-        if (b.second.highlighted())
-            glColor4f(1.0f, 0.0f, 0.0f, 0.0f);
+        if (b.highlighted())
+            draws.push_back({ slot, level, { 1.0f, 0.0f, 0.0f, 0.0f } });
         else
-            glColor4f(0.3f, 0.3f, 0.3f, 0.0f);
-        
-        glCallList( b.second.list() );
+            draws.push_back({ slot, level, { 0.3f, 0.3f, 0.3f, 0.0f } });
     }
+    
+    draw_zones(MeshRenderer::KIND_BOUNDARIES, draws);
 }
 
 void
-MeshGLWidget::compile_tetrahedrons(void)
+MeshGLWidget::draw_tetrahedrons(void)
 {
     if (!_nnm)
         return;
     
-    for ( auto& d : _nnm->domains() )
+    glLineWidth(1);
+    
+    std::vector<MeshRenderer::ZoneDraw> draws;
+    
+    for (size_t slot = 0; slot < _nnm->domains().size(); slot++)
     {
-        GLuint list;
-        
-        list = glGenLists(1);
+        Domain& d = _nnm->domains().zone(slot);
+        GLfloat alpha = d.alpha();
         
-        glNewList(list, GL_COMPILE);
-        glBegin(GL_TRIANGLES);
-        
-        for (auto& t : d.second.objects())
-        {
-            auto pts = t.points();
-            ///////////////////////////////////////////
-            glVertex3f(_nnm->points()[pts.at(0)].x(),
-                       _nnm->points()[pts.at(0)].y(),
-                       _nnm->points()[pts.at(0)].z());
-            
-            glVertex3f(_nnm->points()[pts.at(1)].x(),
-                       _nnm->points()[pts.at(1)].y(),
-                       _nnm->points()[pts.at(1)].z());
-            
-            glVertex3f(_nnm->points()[pts.at(2)].x(),
-                       _nnm->points()[pts.at(2)].y(),
-                       _nnm->points()[pts.at(2)].z());
-            
-            ///////////////////////////////////////////
-            glVertex3f(_nnm->points()[pts.at(0)].x(),
-                       _nnm->points()[pts.at(0)].y(),
-                       _nnm->points()[pts.at(0)].z());
-            
-            glVertex3f(_nnm->points()[pts.at(1)].x(),
-                       _nnm->points()[pts.at(1)].y(),
-                       _nnm->points()[pts.at(1)].z());
-            
-            glVertex3f(_nnm->points()[pts.at(3)].x(),
-                       _nnm->points()[pts.at(3)].y(),
-                       _nnm->points()[pts.at(3)].z());
-            
-            ///////////////////////////////////////////
-            glVertex3f(_nnm->points()[pts.at(0)].x(),
-                       _nnm->points()[pts.at(0)].y(),
-                       _nnm->points()[pts.at(0)].z());
-            
-            glVertex3f(_nnm->points()[pts.at(2)].x(),
-                       _nnm->points()[pts.at(2)].y(),
-                       _nnm->points()[pts.at(2)].z());
-            
-            glVertex3f(_nnm->points()[pts.at(3)].x(),
-                       _nnm->points()[pts.at(3)].y(),
-                       _nnm->points()[pts.at(3)].z());
-            
-            ///////////////////////////////////////////
-            glVertex3f(_nnm->points()[pts.at(1)].x(),
-                       _nnm->points()[pts.at(1)].y(),
-                       _nnm->points()[pts.at(1)].z());
-            
-            glVertex3f(_nnm->points()[pts.at(2)].x(),
-                       _nnm->points()[pts.at(2)].y(),
-                       _nnm->points()[pts.at(2)].z());
-            
-            glVertex3f(_nnm->points()[pts.at(3)].x(),
-                       _nnm->points()[pts.at(3)].y(),
-                       _nnm->points()[pts.at(3)].z());
-            
-        }
+        if ( !d.displayEnabled() )
+            alpha=0.98;
         
-        glEnd();
-        glEndList();
+        if ( !zone_ready(MeshRenderer::KIND_DOMAINS, slot, 0) )
+            continue;
         
-        d.second.setList(list);
+        /*
+         if (sd.second.highlight)
+         glColor4f(1.0f, 0.0f, 0.0f, 0.0f);
+         else
+         glColor4f(0.3f, 0.3f, 0.3f, _mesh_alpha);
+         */
+        draws.push_back({ slot, 0, { d.red(), d.green(),
+                                     d.blue(), alpha } });
+    }
+    
+    draw_zones(MeshRenderer::KIND_DOMAINS, draws);
+}
+
+/* Zone levels not compiled yet are requested; meanwhile the renderer
+ * falls back on any other level of the zone, or skips it. Nothing is
+ * requested without a renderer to take the zones. */
+bool
+MeshGLWidget::zone_ready(MeshRenderer::ZoneKind kind, size_t slot, size_t level)
+{
+    if ( !_renderer.ready() )
+        return false;
+    
+    if ( !_renderer.hasZone(kind, slot, _wireframe, level) &&
+         _pending.insert(zone_key(kind, slot, _wireframe, level)).second )
+    {
+        MeshRenderer::ZoneGeometry g;
+        g.kind = kind;
+        g.slot = slot;
+        g.edges = _wireframe;
+        g.level = level;
+        _requested.push_back(std::move(g));
     }
+    
+    return _renderer.hasZone(kind, slot, _wireframe);
 }
 
+/* Wireframes draw the distinct edges of the zones, each one once */
 void
-MeshGLWidget::draw_tetrahedrons(void)
+MeshGLWidget::draw_zones(MeshRenderer::ZoneKind kind,
+                         const std::vector<MeshRenderer::ZoneDraw>& draws)
+{
+    if (!_wireframe)
+        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    
+    _renderer.drawZones(kind, _wireframe, draws);
+}
+
+/* Only the faces on the outside of each displayed domain; interior
+ * faces would be drawn twice and hidden anyway */
+void
+MeshGLWidget::draw_shells(void)
 {
     if (!_nnm)
         return;
     
     glLineWidth(1);
     
-    for ( auto& d : _nnm->domains() )
+    std::vector<MeshRenderer::ZoneDraw> draws;
+    
+    for (size_t slot = 0; slot < _nnm->domains().size(); slot++)
     {
-        GLfloat alpha = 0.0;
-        
-        if ( !d.second.displayEnabled() )
-            alpha=0.98;
+        Domain& d = _nnm->domains().zone(slot);
         
-        //glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        
-        glColor4f(d.second.red(), d.second.green(),
-                  d.second.blue(), /*d.second.alpha()*/ alpha);
+        if ( !d.displayEnabled() ||
+             !zone_ready(MeshRenderer::KIND_SHELLS, slot, 0) )
+            continue;
         
-        /*
-         if (sd.second.highlight)
-         glColor4f(1.0f, 0.0f, 0.0f, 0.0f);
-         else
-         glColor4f(0.3f, 0.3f, 0.3f, _mesh_alpha);
-         */
-        glCallList( d.second.list() );
+        draws.push_back({ slot, 0, { d.red(), d.green(), d.blue(), 0.0f } });
     }
+    
+    draw_zones(MeshRenderer::KIND_SHELLS, draws);
 }
 
+void
+MeshGLWidget::compile_requested(void)
+{
+    if ( _requested.empty() )
+        return;
+    
+    _compilePool.start( new ZoneCompiler(this, _nnm, _generation, _requested) );
+    _requested.clear();
+}
+
+/* Requests the full detail zones of the scene that are missing; true
+ * when they are all uploaded */
+bool
+MeshGLWidget::scene_ready(void)
+{
+    MeshRenderer::ZoneKind kind = MeshRenderer::KIND_DOMAINS;
+    size_t count = _nnm->domains().size();
+    
+    if (whatToDraw == DRAW_TRIANGLES)
+    {
+        kind = MeshRenderer::KIND_BOUNDARIES;
+        count = _nnm->boundaries().size();
+    }
+    else if (whatToDraw == DRAW_SHELLS)
+        kind = MeshRenderer::KIND_SHELLS;
+    
+    bool ready = true;
+    
+    for (size_t slot = 0; slot < count; slot++)
+        if ( !_renderer.hasZone(kind, slot, _wireframe, 0) )
+        {
+            zone_ready(kind, slot, 0);
+            ready = false;
+        }
+    
+    compile_requested();
+    return ready;
+}
+
+/* Called on the compiler thread; false when the mesh has changed and
+ * the rest of the batch is not needed anymore */
+bool
+MeshGLWidget::zone_built(unsigned generation, MeshRenderer::ZoneGeometry& g)
+{
+    std::lock_guard<std::mutex> lock(_compiledMutex);
+    
+    if (generation != _generation)
+        return false;
+    
+    _compiled.push_back(std::move(g));
+    
+    /* One upload for all the zones completed before it gets to run */
+    if (_compiled.size() == 1)
+        QMetaObject::invokeMethod(this, "uploadZones", Qt::QueuedConnection);
+    
+    return true;
+}
+
+void
+MeshGLWidget::uploadZones(void)
+{
+    std::vector<MeshRenderer::ZoneGeometry> compiled;
+    
+    {
+        std::lock_guard<std::mutex> lock(_compiledMutex);
+        compiled.swap(_compiled);
+    }
+    
+    if ( compiled.empty() )
+        return;
+    
+    makeCurrent();
+    
+    /* A zone the renderer turns down stays pending, so that it is not
+     * asked for again until the next mesh */
+    bool uploaded = false;
+    for (auto& g : compiled)
+        if ( _renderer.uploadZone(g) )
+        {
+            _pending.erase( zone_key(g.kind, g.slot, g.edges, g.level) );
+            uploaded = true;
+        }
+    
+    if (uploaded)
+        update();
+}
+
+void
+MeshGLWidget::draw_preview(void)
+{
+    glLineWidth(1);
+    glPointSize(1);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    _renderer.setColor(0.3f, 0.3f, 0.3f, 0.0f);
+    _renderer.drawPreview();
+}
+
+void
+MeshGLWidget::addPreviewPoints(QVector<GLfloat> xyz)
+{
+    makeCurrent();
+    _renderer.addPreview(GL_POINTS, xyz.constData(), xyz.size()/3);
+    update();
+}
+
+void
+MeshGLWidget::addPreviewTriangles(QVector<GLfloat> xyz)
+{
+    /* Triangles can only show up after the points */
+    if ( !_renderer.hasPreview() )
+        return;
+    
+    makeCurrent();
+    _renderer.addPreview(GL_TRIANGLES, xyz.constData(), xyz.size()/3);
+    update();
+}
+
+void
+MeshGLWidget::clearPreview(void)
+{
+    if ( !_renderer.hasPreview() )
+        return;
+    
+    makeCurrent();
+    _renderer.clearPreview();
+    update();
+}
 
 void
 MeshGLWidget::setDrawTetrahedrons(void)
@@ -358,6 +601,60 @@ MeshGLWidget::setDrawTriangles(void)
     updateGL();
 }
 
+void
+MeshGLWidget::setDrawShells(void)
+{
+    whatToDraw = DRAW_SHELLS;
+    updateGL();
+}
+
+void
+MeshGLWidget::setWireframe(bool wireframe)
+{
+    _wireframe = wireframe;
+    updateGL();
+}
+
+/* Only the points are uploaded again, the zones do not change. The
+ * renderer can turn quantization down, which is reported back. */
+void
+MeshGLWidget::setQuantized(bool quantized)
+{
+    makeCurrent();
+    bool accepted = _renderer.setQuantized(quantized);
+    
+    if (_nnm)
+    {
+        _renderer.uploadPoints( _nnm->points() );
+        accepted = _renderer.quantized();
+    }
+    
+    report_quantization();
+    emit quantizedChanged(accepted);
+    updateGL();
+}
+
+/* How far quantization moves the points on screen at the largest zoom */
+void
+MeshGLWidget::report_quantization(void)
+{
+    QString report;
+    
+    if ( _renderer.quantized() )
+    {
+        double pixels = _renderer.quantizationError() * _zoom_max *
+                        height() / (2*VIEW_SCALE);
+        
+        if (pixels < 0.5)
+            QTextStream(&report) << "Quantization not visible";
+        else
+            QTextStream(&report) << "Quantization error up to " << pixels
+                                 << " pixels at maximum zoom";
+    }
+    
+    emit quantizationReport(report);
+}
+
 void
 MeshGLWidget::mousePressEvent(QMouseEvent *e)
 {
@@ -404,7 +701,7 @@ MeshGLWidget::mouseMoveEvent(QMouseEvent *e)
     _prevX = e->x();
     _prevY = e->y();
     
-    updateGL();
+    interact();
 }
 
 void
@@ -424,21 +721,210 @@ MeshGLWidget::wheelEvent(QWheelEvent *e)
     
     e->accept();
     
-    updateGL();
+    interact();
 }
 
 void
-MeshGLWidget::setMesh(std::shared_ptr<NetgenNeutralMesh> nnm)
+MeshGLWidget::interact(void)
 {
-    _nnm = nnm;
-    compile_triangles();
-    compile_tetrahedrons();
+    _interacting = true;
+    _refineTimer.start();
     update();
 }
 
+void
+MeshGLWidget::refine(void)
+{
+    _interacting = false;
+    update();
+}
 
+/* Levels of detail dropped while the camera moves, each with about a
+ * quarter of the triangles of the previous one; 0 for full quality */
+size_t
+MeshGLWidget::reduction(void) const
+{
+    if ( !_interacting || !_nnm || _nnm->boundaries().size() == 0 ||
+         _fullFrameTime <= _frameBudget )
+        return 0;
+    
+    size_t bias = 1;
+    for (double t = _fullFrameTime/4; t > _frameBudget; t /= 4)
+        if (++bias == LOD_LEVELS-1)
+            break;
+    
+    return bias;
+}
 
+void
+MeshGLWidget::setFrameBudget(int ms)
+{
+    _frameBudget = ms;
+}
+
+void
+MeshGLWidget::setMesh(std::shared_ptr<NetgenNeutralMesh> nnm)
+{
+    if (_exporter)
+    {
+        _exportCancelled = true;
+        end_export(false);
+    }
+    
+    clearPreview();
+    
+    {
+        std::lock_guard<std::mutex> lock(_compiledMutex);
+        _generation++;
+        _compiled.clear();
+    }
+    _requested.clear();
+    _pending.clear();
+    
+    _nnm = nnm;
+    
+    makeCurrent();
+    if (_nnm)
+        _renderer.setMesh(*_nnm);
+    else
+        _renderer.clearMesh();
+    
+    report_quantization();
+    
+    if (_nnm)
+        emit quantizedChanged( _renderer.quantized() );
+    
+    /* Proxies of all the boundaries, coarsest first, so that a zoomed
+     * out view never waits for the full ones */
+    if ( _nnm && _renderer.ready() )
+    {
+        std::vector<MeshRenderer::ZoneGeometry> proxies;
+        
+        for (size_t level = LOD_LEVELS-1; level > 0; level--)
+            for (size_t slot = 0; slot < _nnm->boundaries().size(); slot++)
+            {
+                MeshRenderer::ZoneGeometry g;
+                g.kind = MeshRenderer::KIND_BOUNDARIES;
+                g.slot = slot;
+                g.edges = _wireframe;
+                g.level = level;
+                _pending.insert( zone_key(g.kind, g.slot, g.edges, g.level) );
+                proxies.push_back(std::move(g));
+            }
+        
+        _lodPool.start( new ZoneCompiler(this, _nnm, _generation, proxies) );
+    }
+    
+    update();
+}
 
+bool
+MeshGLWidget::exportTurntable(const QString& path, int width, int height,
+                              int frames)
+{
+    if (!_nnm || !_renderer.ready() || frames <= 0 || _exporter)
+        return false;
+    
+    makeCurrent();
+    
+    std::unique_ptr<FrameExporter> exporter(
+        new FrameExporter(_renderer.functions()) );
+    if ( !exporter->begin(path, width, height) )
+        return false;
+    
+    _exporter = std::move(exporter);
+    _exportFrame = 0;
+    _exportFrames = frames;
+    _exportAspect = width/(double)height;
+    _exportRotY = _rotY;
+    _exportWhat = whatToDraw;
+    _exportWireframe = _wireframe;
+    _exportCancelled = false;
+    
+    _exportTimer.start(0);
+    return true;
+}
 
+void
+MeshGLWidget::cancelExport(void)
+{
+    if (_exporter)
+        _exportCancelled = true;
+}
 
+/* One frame of the export, drawn with the settings it started with,
+ * whatever the view shows meanwhile. The transparency targets of the
+ * export are kept apart, so that neither the view nor the export has
+ * to build them again at every frame. */
+void
+MeshGLWidget::exportStep(void)
+{
+    if (_exportCancelled)
+    {
+        end_export(false);
+        return;
+    }
+    
+    makeCurrent();
+    
+    WhatToDraw what = whatToDraw;
+    bool wireframe = _wireframe;
+    GLfloat rotY = _rotY;
+    
+    whatToDraw = _exportWhat;
+    _wireframe = _exportWireframe;
+    
+    bool ready = scene_ready();
+    
+    if (ready)
+    {
+        _rotY = _exportRotY + 360.0f*_exportFrame/_exportFrames;
+        _fullDetail = true;
+        _renderer.setCulling(true, 1);
+        _renderer.useTargets(MeshRenderer::TARGETS_OFFSCREEN);
+        
+        _exporter->target();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        prepare_tritet_view(_exportAspect);
+        
+        _renderer.begin();
+        draw_scene();
+        _renderer.end();
+        
+        _exporter->capture();
+        
+        _renderer.useTargets(MeshRenderer::TARGETS_VIEW);
+        _fullDetail = false;
+        _exportFrame++;
+    }
+    
+    whatToDraw = what;
+    _wireframe = wireframe;
+    _rotY = rotY;
+    glViewport(0, 0, this->width(), this->height());
+    
+    /* No need to spin while the zones are being compiled */
+    _exportTimer.start(ready ? 0 : EXPORT_WAIT_MS);
+    
+    if (!ready)
+        return;
+    
+    emit exportProgress( 100*_exportFrame/_exportFrames );
+    
+    if (_exportFrame == _exportFrames)
+        end_export(true);
+}
 
+void
+MeshGLWidget::end_export(bool ok)
+{
+    _exportTimer.stop();
+    
+    makeCurrent();
+    ok = _exporter->finish() && ok;
+    _exporter.reset();
+    _renderer.releaseTargets(MeshRenderer::TARGETS_OFFSCREEN);
+    
+    update();
+    emit exportFinished(ok);
+}
@@ -31,14 +31,29 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include <set>
+#include <mutex>
 
 #include <QtGui>
 #include <QGLWidget>
+#include <QThreadPool>
+#include <QTimer>
+#include <QElapsedTimer>
 #include "Mesh.h"
+#include "MeshRenderer.h"
+#include "FrameTimer.h"
+#include "View.h"
+
+class FrameExporter;
+
+/* Frames of an exported turntable, for a full turn */
+#define TURNTABLE_FRAMES    360
 
 enum WhatToDraw {
     DRAW_TRIANGLES,
-    DRAW_TETRAHEDRONS
+    DRAW_TETRAHEDRONS,
+    DRAW_SHELLS
 };
 
 class MeshGLWidget : public QGLWidget
@@ -46,12 +61,23 @@ class MeshGLWidget : public QGLWidget
     Q_OBJECT
     
 private:
-    void            prepare_tritet_view(void);
+    void            prepare_tritet_view(double);
     void            draw_axes(void);
-    void            draw_triangles(void);
-    void            compile_triangles(void);
+    void            draw_triangles(size_t);
     void            draw_tetrahedrons(void);
-    void            compile_tetrahedrons(void);
+    void            draw_shells(void);
+    void            draw_scene(void);
+    bool            zone_ready(MeshRenderer::ZoneKind, size_t, size_t);
+    void            draw_zones(MeshRenderer::ZoneKind,
+                               const std::vector<MeshRenderer::ZoneDraw>&);
+    void            compile_requested(void);
+    bool            scene_ready(void);
+    bool            zone_built(unsigned, MeshRenderer::ZoneGeometry&);
+    void            draw_preview(void);
+    void            report_quantization(void);
+    void            interact(void);
+    size_t          reduction(void) const;
+    void            end_export(bool);
     
     GLfloat         _rotX, _rotY;
     GLfloat         _tranX, _tranY;
@@ -62,9 +88,54 @@ private:
     int             _prevX, _prevY;
     
     WhatToDraw      whatToDraw;
+    bool            _wireframe;
     
     std::shared_ptr<NetgenNeutralMesh> _nnm;
     
+    MeshRenderer    _renderer;
+    QString         _glError;       /* Shown in place of the mesh */
+    
+    /* Zones are compiled the first time they are drawn: the ones
+     * missing from a frame are built in one batch on _compilePool,
+     * then uploaded here. Results of a batch started for a previous
+     * mesh are dropped by generation. Boundary proxies are built
+     * ahead on _lodPool when a mesh is set. */
+    QThreadPool                             _compilePool;
+    QThreadPool                             _lodPool;
+    std::vector<MeshRenderer::ZoneGeometry> _requested;
+    std::set<size_t>                        _pending;
+    
+    std::mutex                              _compiledMutex;
+    std::vector<MeshRenderer::ZoneGeometry> _compiled;
+    unsigned                                _generation;
+    
+    friend class ZoneCompiler;
+    
+    /* Input only schedules a repaint, so that events are coalesced in
+     * one frame per vsync. While the camera moves and full frames take
+     * longer than the budget, boundary proxies stand in for the mesh
+     * until _refineTimer fires. */
+    QTimer                                  _refineTimer;
+    QElapsedTimer                           _frameTimer;
+    FrameTimer                              _gpuTimer;
+    bool                                    _interacting;
+    int                                     _frameBudget;      /* ms */
+    double                                  _fullFrameTime;    /* ms */
+    
+    /* A turntable export renders a frame per event loop iteration on
+     * _exportTimer, as the view was when it started, once the full
+     * detail zones it needs are compiled. Frames are drawn with those
+     * only, never with proxies. */
+    std::unique_ptr<FrameExporter>          _exporter;
+    QTimer                                  _exportTimer;
+    int                                     _exportFrame, _exportFrames;
+    double                                  _exportAspect;
+    GLfloat                                 _exportRotY;
+    WhatToDraw                              _exportWhat;
+    bool                                    _exportWireframe;
+    bool                                    _exportCancelled;
+    bool                                    _fullDetail;
+    
 protected:
     virtual void    initializeGL();
     virtual void    paintGL();
@@ -77,12 +148,46 @@ protected:
 public slots:
     void    setDrawTetrahedrons(void);
     void    setDrawTriangles(void);
+    void    setDrawShells(void);
+    void    setWireframe(bool);
+    void    setQuantized(bool);
+    void    setFrameBudget(int);
+    
+    void    addPreviewPoints(QVector<GLfloat>);
+    void    addPreviewTriangles(QVector<GLfloat>);
+    void    clearPreview(void);
+    
+    void    cancelExport(void);
+    
+private slots:
+    void    uploadZones(void);
+    void    refine(void);
+    void    exportStep(void);
+    
+signals:
+    /* Empty when the points are not quantized */
+    void    quantizationReport(QString);
+    
+    /* Whether the points are quantized, after a request or a new mesh */
+    void    quantizedChanged(bool);
+    
+    /* Percent of the frames of an export rendered, then whether all
+     * of them were written */
+    void    exportProgress(int);
+    void    exportFinished(bool);
     
 public:
     MeshGLWidget( QWidget *parent = 0 );
+    ~MeshGLWidget();
     
     void            setMesh(std::shared_ptr<NetgenNeutralMesh>);
     
+    /* Starts rendering a full turn about the vertical axis from the
+     * current view, at the given size and number of frames, to a PNG
+     * sequence or a raw video (see FrameExporter); false if it cannot
+     * start. The view stays interactive meanwhile. */
+    bool            exportTurntable(const QString&, int, int, int);
+    bool            exportCancelled(void) const { return _exportCancelled; }
 };
 
 
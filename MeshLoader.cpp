@@ -0,0 +1,146 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+
+#include <QRegExp>
+
+#include "MeshLoader.h"
+#include "NetgenVolMesh.h"
+#include "GmshMesh.h"
+
+MeshLoader::MeshLoader(const QString& path,
+                       std::shared_ptr<NetgenNeutralMesh> mesh,
+                       QObject *parent)
+    : QThread(parent), _path(path), _mesh(mesh),
+      _cancel(false), _percent(-1), _ok(false), _points(nullptr)
+{
+    qRegisterMetaType< QVector<GLfloat> >("QVector<GLfloat>");
+}
+
+void
+MeshLoader::run()
+{
+    _mesh->setLoadMonitor(this);
+    _ok = _mesh->load(_path.toStdString(), true) && !_cancel;
+    _mesh->setLoadMonitor(nullptr);
+}
+
+bool
+MeshLoader::progress(size_t done, size_t total)
+{
+    int percent = total ? int( (100.0*done)/total ) : 100;
+    int prev = _percent;
+    
+    /* Called concurrently by the parser threads: emit only when the
+     * value grows, so the progress bar never goes backwards */
+    while (percent > prev)
+    {
+        if ( _percent.compare_exchange_weak(prev, percent) )
+        {
+            emit progressChanged(percent);
+            break;
+        }
+    }
+    
+    return !_cancel;
+}
+
+void
+MeshLoader::pointsLoaded(const PointStore& points)
+{
+    /* The points are not touched again until the load completes */
+    _points = &points;
+    
+    QVector<GLfloat> xyz(points.size()*3);
+    std::copy(points.render(), points.render() + xyz.size(), xyz.data());
+    
+    emit previewPoints(xyz);
+}
+
+void
+MeshLoader::trianglesLoaded(const Triangle *tris, size_t count)
+{
+    if (!_points || _cancel)
+        return;
+    
+    QVector<GLfloat> xyz(count*9);
+    const GLfloat *src = _points->render();
+    GLfloat *out = xyz.data();
+    
+    for (size_t i = 0; i < count; i++)
+    {
+        for (size_t p : tris[i].points())
+        {
+            *out++ = src[3*p+0];
+            *out++ = src[3*p+1];
+            *out++ = src[3*p+2];
+        }
+    }
+    
+    emit previewTriangles(xyz);
+}
+
+/* The points are cleared before the parser starts over */
+void
+MeshLoader::loadRestarted(void)
+{
+    _points = nullptr;
+    emit previewCleared();
+}
+
+void
+MeshLoader::cancel(void)
+{
+    _cancel = true;
+}
+
+std::shared_ptr<NetgenNeutralMesh>
+MeshLoader::mesh(void)
+{
+    return _ok ? _mesh : nullptr;
+}
+
+/* Compressed files are detected by content, the format by the name
+ * under the compression suffix */
+std::shared_ptr<NetgenNeutralMesh>
+MeshLoader::makeMesh(const QString& path)
+{
+    QString name = path;
+    name.remove(QRegExp("\\.(gz|zst)$", Qt::CaseInsensitive));
+    
+    if ( name.endsWith(".vol", Qt::CaseInsensitive) )
+        return std::make_shared<NetgenVolMesh>();
+    
+    if ( name.endsWith(".msh", Qt::CaseInsensitive) )
+        return std::make_shared<GmshMesh>();
+    
+    return std::make_shared<NetgenNeutralMesh>();
+}
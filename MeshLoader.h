@@ -0,0 +1,97 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <memory>
+#include <atomic>
+
+#include <QThread>
+#include <QString>
+#include <QVector>
+
+#include "Mesh.h"
+
+/*******************************************************************/
+/* Loads a mesh on its own thread. Progress is reported in percent of
+ * the input bytes through progressChanged(); when the thread finishes,
+ * succeeded() and mesh() tell the outcome. The mesh is handed out only
+ * if it was loaded completely.
+ *
+ * While loading, previewPoints() and previewTriangles() deliver the
+ * geometry known so far as flat xyz float arrays (one vertex per point,
+ * three per triangle), for a progressive display. previewCleared()
+ * means that the geometry delivered so far is to be dropped.
+ */
+class MeshLoader : public QThread, public LoadMonitor
+{
+    Q_OBJECT
+    
+    QString                             _path;
+    std::shared_ptr<NetgenNeutralMesh>  _mesh;
+    
+    std::atomic<bool>                   _cancel;
+    std::atomic<int>                    _percent;
+    bool                                _ok;
+    
+    const PointStore                    *_points;
+    
+protected:
+    virtual void    run();
+    
+signals:
+    void    progressChanged(int);
+    void    previewPoints(QVector<GLfloat>);
+    void    previewTriangles(QVector<GLfloat>);
+    void    previewCleared(void);
+    
+public slots:
+    void    cancel(void);
+    
+public:
+    /* Fills the given, empty, mesh object from the file */
+    MeshLoader(const QString&, std::shared_ptr<NetgenNeutralMesh>,
+               QObject *parent = 0);
+    
+    virtual bool    progress(size_t, size_t);
+    virtual void    pointsLoaded(const PointStore&);
+    virtual void    trianglesLoaded(const Triangle *, size_t);
+    virtual void    loadRestarted(void);
+    
+    QString         path(void) const { return _path; }
+    bool            succeeded(void) const { return _ok; }
+    bool            cancelled(void) const { return _cancel; }
+    
+    std::shared_ptr<NetgenNeutralMesh>  mesh(void);
+    
+    /* Empty mesh of the format of a file, told by its name */
+    static std::shared_ptr<NetgenNeutralMesh>  makeMesh(const QString&);
+};
+
@@ -0,0 +1,1626 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <cmath>
+
+#include "MeshRenderer.h"
+#include "Parallel.h"
+#include "Edges.h"
+#include "Lod.h"
+
+/* Elements of a zone culled together */
+#define CHUNK_ELEMENTS  4096
+
+/* Largest size on screen of the clustering cells of a proxy */
+#define LOD_CELL_PIXELS 2
+
+namespace {
+
+#define STRINGIFY(x)    #x
+#define TOSTRING(x)     STRINGIFY(x)
+
+/* Vertex shaders are put together from a header, the code that
+ * transforms a point in the vertex format, and the body */
+const char *base_header =
+    "#version 120\n";
+
+/* Texture buffers, texelFetch() and gl_VertexID are there from
+ * GLSL 1.40 on */
+const char *glsl140_header =
+    "#version 140\n";
+
+const char *multidraw_header =
+    "#version 430 compatibility\n"
+    "#extension GL_ARB_shader_draw_parameters : require\n";
+
+const char *float_position_source =
+    "attribute vec3 position;\n"
+    "vec4 transformed()\n"
+    "{\n"
+    "    return gl_ModelViewProjectionMatrix * vec4(position, 1.0);\n"
+    "}\n";
+
+/* Two texels per block: the center of its box, then the half size */
+const char *quantized_position_source =
+    "in vec3 position;\n"
+    "in float block;\n"
+    "uniform mat4 transform;\n"
+    "uniform samplerBuffer blocks;\n"
+    "vec4 transformed()\n"
+    "{\n"
+    "    int texel = 2*int(block);\n"
+    "    vec3 center = texelFetch(blocks, texel).xyz;\n"
+    "    vec3 half_size = texelFetch(blocks, texel + 1).xyz;\n"
+    "    return transform * vec4(center + half_size*position, 1.0);\n"
+    "}\n";
+
+const char *vertex_source =
+    "void main()\n"
+    "{\n"
+    "    gl_Position = transformed();\n"
+    "}\n";
+
+/* The color is looked up in the fragment shader: storage buffers are
+ * not guaranteed to be available to vertex shaders */
+const char *multidraw_vertex_source =
+    "flat out int style;\n"
+    "void main()\n"
+    "{\n"
+    "    style = gl_BaseInstanceARB;\n"
+    "    gl_Position = transformed();\n"
+    "}\n";
+
+/* Fragment shaders are put together from a header, the code that
+ * gives the color of the zone, and the output of the pass */
+const char *uniform_color_source =
+    "uniform vec4 color;\n"
+    "vec4 zone_color()\n"
+    "{\n"
+    "    return color;\n"
+    "}\n";
+
+const char *multidraw_color_source =
+    "layout(std430, binding = 0) readonly buffer Styles { vec4 colors[]; };\n"
+    "flat in int style;\n"
+    "vec4 zone_color()\n"
+    "{\n"
+    "    return colors[style];\n"
+    "}\n";
+
+const char *opaque_output_source =
+    "void main()\n"
+    "{\n"
+    "    gl_FragColor = zone_color();\n"
+    "}\n";
+
+/* Alpha is the transparency, as for glBlendFunc(GL_ONE_MINUS_SRC_ALPHA,
+ * GL_SRC_ALPHA). The weight favours what is close to the eye (McGuire
+ * and Bavoil, equation 10). */
+const char *weighted_output_source =
+    "void main()\n"
+    "{\n"
+    "    vec4 c = zone_color();\n"
+    "    float a = 1.0 - c.a;\n"
+    "    float w = clamp(a * 3e3 * pow(1.0 - gl_FragCoord.z, 3.0), 1e-2, 3e3);\n"
+    "    gl_FragData[0] = vec4(c.rgb * a, a) * w;\n"
+    "    gl_FragData[1] = vec4(a);\n"
+    "}\n";
+
+/* A triangle covering the viewport; the output alpha is the revealage,
+ * blended as a transparency over the frame */
+const char *composite_vertex_source =
+    "void main()\n"
+    "{\n"
+    "    vec2 p = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 4.0 - 1.0;\n"
+    "    gl_Position = vec4(p, 0.0, 1.0);\n"
+    "}\n";
+
+const char *composite_fragment_source =
+    "uniform sampler2D accumulation;\n"
+    "uniform sampler2D revealage;\n"
+    "void main()\n"
+    "{\n"
+    "    ivec2 p = ivec2(gl_FragCoord.xy);\n"
+    "    float r = texelFetch(revealage, p, 0).r;\n"
+    "    if (r == 1.0)\n"
+    "        discard;\n"
+    "    vec4 a = texelFetch(accumulation, p, 0);\n"
+    "    gl_FragColor = vec4(a.rgb / max(a.a, 1e-5), r);\n"
+    "}\n";
+
+/* Texture units of the samplers of all the programs */
+const struct {
+    const char  *name;
+    GLint       unit;
+} sampler_units[] = {
+    { "blocks",         0 },
+    { "accumulation",   0 },
+    { "revealage",      1 },
+};
+
+GLuint
+compile_shader(const GLFunctions& gl, GLenum type, const char * const *sources,
+               GLsizei count)
+{
+    GLuint shader = gl.CreateShader(type);
+    gl.ShaderSource(shader, count, sources, nullptr);
+    gl.CompileShader(shader);
+    
+    GLint status;
+    gl.GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status)
+    {
+        char log[1024];
+        gl.GetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        std::cout << "Shader compilation failed: " << log << std::endl;
+        gl.DeleteShader(shader);
+        return 0;
+    }
+    
+    return shader;
+}
+
+/* Spreads the lower 10 bits of v to every third bit */
+uint32_t
+spread_bits(uint32_t v)
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8))  & 0x0300f00f;
+    v = (v | (v << 4))  & 0x030c30c3;
+    v = (v | (v << 2))  & 0x09249249;
+    return v;
+}
+
+/* Morton code of a normalized point, coordinates in [-0.5, 0.5] */
+uint32_t
+morton_code(const GLfloat *xyz)
+{
+    uint32_t code = 0;
+    
+    for (size_t i = 0; i < 3; i++)
+    {
+        float q = std::min(std::max(xyz[i] + 0.5f, 0.0f), 1.0f) * 1023.0f;
+        code |= spread_bits(uint32_t(q)) << i;
+    }
+    
+    return code;
+}
+
+/* Signed normalized integers decode as s/32767 from OpenGL 4.2 on,
+ * as (2s+1)/65535 before; points are encoded for the rule in use */
+GLshort
+encode_snorm(GLfloat v, bool gl42)
+{
+    GLfloat s = gl42 ? v*32767.0f : (v*65535.0f - 1.0f)/2;
+    return GLshort( std::lround(std::min(std::max(s, -32768.0f), 32767.0f)) );
+}
+
+GLfloat
+decode_snorm(GLshort s, bool gl42)
+{
+    return gl42 ? std::max(s/32767.0f, -1.0f) : (2.0f*s + 1.0f)/65535.0f;
+}
+
+/* Splits points sorted by Morton code in blocks of at most POINT_BLOCK
+ * points that do not straddle the octree cell of the given level;
+ * small sibling cells share a block. starts gets the first point of
+ * every block. */
+void
+split_blocks(const std::vector<uint64_t>& order, size_t begin, size_t end,
+             unsigned shift, std::vector<size_t>& starts)
+{
+    if (end - begin <= POINT_BLOCK || shift == 0)
+    {
+        for (size_t b = begin; b < end; b += POINT_BLOCK)
+            starts.push_back(b);
+        return;
+    }
+    
+    shift -= 3;
+    
+    size_t run = begin;
+    for (size_t cb = begin; cb < end; )
+    {
+        uint64_t cell = (order[cb] >> 32) >> shift;
+        size_t ce = cb;
+        while ( ce < end && ((order[ce] >> 32) >> shift) == cell )
+            ce++;
+        
+        if (ce - cb > POINT_BLOCK)
+        {
+            if (run < cb)
+                starts.push_back(run);
+            split_blocks(order, cb, ce, shift, starts);
+            run = ce;
+        }
+        else if (ce - run > POINT_BLOCK)
+        {
+            starts.push_back(run);
+            run = cb;
+        }
+        
+        cb = ce;
+    }
+    
+    if (run < end)
+        starts.push_back(run);
+}
+
+/* Points as 16 bit normalized integers relative to the box of their
+ * block, and the boxes as center and half size. Blocks are made of
+ * points close in Morton order, so that their boxes are small whatever
+ * the order of the points in the file; the fourth component of a point
+ * is its block. Gives the largest error along an axis, or false with
+ * more blocks than that component can tell apart. */
+bool
+quantize_points(const GLfloat *xyz, size_t count, bool gl42,
+                std::vector<GLshort>& q, std::vector<GLfloat>& blocks,
+                GLfloat& error)
+{
+    std::vector<uint64_t> order(count);
+    parallel_for((count + POINT_BLOCK - 1)/POINT_BLOCK, [&](size_t c) {
+        size_t end = std::min(count, (c+1)*POINT_BLOCK);
+        
+        for (size_t p = c*POINT_BLOCK; p < end; p++)
+            order[p] = (uint64_t(morton_code(&xyz[3*p])) << 32) | p;
+    });
+    
+    /* Keys are all distinct, nothing gets removed */
+    sort_unique_keys(order);
+    
+    std::vector<size_t> starts;
+    split_blocks(order, 0, count, 30, starts);
+    
+    size_t nblocks = starts.size();
+    if (nblocks > MAX_POINT_BLOCKS)
+        return false;
+    
+    starts.push_back(count);
+    
+    std::vector<GLfloat> errors(nblocks, 0.0f);
+    
+    q.resize(4*count);
+    blocks.assign(8*nblocks, 0.0f);
+    
+    parallel_for(nblocks, [&](size_t b) {
+        size_t begin = starts[b];
+        size_t end = starts[b+1];
+        GLfloat *center = &blocks[8*b];
+        GLfloat *half = &blocks[8*b + 4];
+        
+        for (size_t i = 0; i < 3; i++)
+        {
+            GLfloat min = std::numeric_limits<GLfloat>::max();
+            GLfloat max = -min;
+            
+            for (size_t k = begin; k < end; k++)
+            {
+                size_t p = uint32_t(order[k]);
+                min = std::min(min, xyz[3*p + i]);
+                max = std::max(max, xyz[3*p + i]);
+            }
+            
+            center[i] = (min + max)/2;
+            half[i] = (max - min)/2;
+        }
+        
+        for (size_t k = begin; k < end; k++)
+        {
+            size_t p = uint32_t(order[k]);
+            
+            for (size_t i = 0; i < 3; i++)
+            {
+                GLfloat v = 0.0f;
+                if (half[i] > 0)
+                    v = (xyz[3*p + i] - center[i])/half[i];
+                
+                GLshort s = encode_snorm(v, gl42);
+                GLfloat decoded = center[i] + half[i]*decode_snorm(s, gl42);
+                
+                q[4*p + i] = s;
+                errors[b] = std::max(errors[b],
+                                     std::fabs(decoded - xyz[3*p + i]));
+            }
+            
+            q[4*p + 3] = GLshort( uint16_t(b) );
+        }
+    });
+    
+    error = nblocks ? *std::max_element(errors.begin(), errors.end()) : 0.0f;
+    return true;
+}
+
+/* Tetrahedrons are drawn as their four faces, the rest as they are */
+void
+emit_faces(const Tetrahedron& t, std::vector<uint32_t>& out)
+{
+    static const int local[12] = {
+        0, 1, 2,  0, 1, 3,  0, 2, 3,  1, 2, 3
+    };
+    
+    for (size_t i = 0; i < 12; i++)
+        out.push_back(t[local[i]]);
+}
+
+template<typename T>
+void
+emit_faces(const T& e, std::vector<uint32_t>& out)
+{
+    for (auto p : e.points())
+        out.push_back(p);
+}
+
+/* An edge on the border of several chunks goes to the first of them
+ * only. keys holds the sorted distinct edges of each chunk; parts gets
+ * the point indices of the edges each chunk keeps. */
+static void
+assign_edges(const std::vector<std::vector<uint64_t>>& keys,
+             std::vector<std::vector<uint32_t>>& parts)
+{
+    std::vector<uint64_t> all;
+    for (auto& k : keys)
+        all.insert(all.end(), k.begin(), k.end());
+    
+    sort_unique_keys(all);
+    
+    /* Position of every chunk edge in the zone edges */
+    std::vector<std::vector<uint32_t>> where(keys.size());
+    parallel_for(keys.size(), [&](size_t c) {
+        where[c].reserve(keys[c].size());
+        for (auto key : keys[c])
+            where[c].push_back( std::lower_bound(all.begin(), all.end(), key)
+                                - all.begin() );
+    });
+    
+    const uint32_t NO_CHUNK = uint32_t(-1);
+    std::vector<uint32_t> owner(all.size(), NO_CHUNK);
+    
+    for (size_t c = 0; c < keys.size(); c++)
+        for (auto w : where[c])
+            if (owner[w] == NO_CHUNK)
+                owner[w] = c;
+    
+    parallel_for(keys.size(), [&](size_t c) {
+        for (size_t i = 0; i < keys[c].size(); i++)
+            if ( owner[ where[c][i] ] == c )
+            {
+                parts[c].push_back( edge_first(keys[c][i]) );
+                parts[c].push_back( edge_second(keys[c][i]) );
+            }
+    });
+}
+
+/* Faces or distinct edges of the elements, as indices, in chunks of
+ * CHUNK_ELEMENTS elements that are close to each other: elements are
+ * ordered by the Morton code of their centroid. Every edge of the zone
+ * is drawn by one chunk. */
+template<typename T>
+void
+build_chunks(const GLfloat *xyz, const T *elems, size_t count,
+             MeshRenderer::ZoneGeometry& geom)
+{
+    const size_t npts = std::tuple_size<decltype(elems->points())>::value;
+    
+    std::vector<uint64_t> order(count);
+    parallel_for((count + CHUNK_ELEMENTS - 1)/CHUNK_ELEMENTS, [&](size_t c) {
+        size_t end = std::min(count, (c+1)*CHUNK_ELEMENTS);
+        
+        for (size_t e = c*CHUNK_ELEMENTS; e < end; e++)
+        {
+            GLfloat centroid[3] = { 0, 0, 0 };
+            for (auto p : elems[e].points())
+                for (size_t i = 0; i < 3; i++)
+                    centroid[i] += xyz[3*size_t(p) + i]/npts;
+            
+            order[e] = (uint64_t(morton_code(centroid)) << 32) | e;
+        }
+    });
+    
+    /* Keys are all distinct, nothing gets removed */
+    sort_unique_keys(order);
+    
+    size_t nchunks = (count + CHUNK_ELEMENTS - 1)/CHUNK_ELEMENTS;
+    std::vector<std::vector<uint32_t>> parts(nchunks);
+    std::vector<std::vector<uint64_t>> edges(geom.edges ? nchunks : 0);
+    geom.chunks.resize(nchunks);
+    
+    parallel_for(nchunks, [&](size_t c) {
+        size_t end = std::min(count, (c+1)*CHUNK_ELEMENTS);
+        MeshRenderer::ZoneChunk& chunk = geom.chunks[c];
+        std::vector<uint32_t>& part = parts[c];
+        std::vector<uint64_t> keys;
+        
+        for (size_t i = 0; i < 3; i++)
+        {
+            chunk.min[i] = std::numeric_limits<GLfloat>::max();
+            chunk.max[i] = -std::numeric_limits<GLfloat>::max();
+        }
+        
+        for (size_t k = c*CHUNK_ELEMENTS; k < end; k++)
+        {
+            const T& e = elems[ uint32_t(order[k]) ];
+            auto pts = e.points();
+            
+            for (auto p : pts)
+                for (size_t i = 0; i < 3; i++)
+                {
+                    chunk.min[i] = std::min(chunk.min[i], xyz[3*size_t(p) + i]);
+                    chunk.max[i] = std::max(chunk.max[i], xyz[3*size_t(p) + i]);
+                }
+            
+            if (!geom.edges)
+            {
+                emit_faces(e, part);
+                continue;
+            }
+            
+            for (size_t i = 0; i < pts.size(); i++)
+                for (size_t j = i+1; j < pts.size(); j++)
+                    keys.push_back( edge_key(pts[i], pts[j]) );
+        }
+        
+        if (geom.edges)
+        {
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+            edges[c].swap(keys);
+        }
+    });
+    
+    if (geom.edges)
+        assign_edges(edges, parts);
+    
+    for (size_t c = 0; c < nchunks; c++)
+    {
+        geom.chunks[c].first = geom.indices.size();
+        geom.chunks[c].count = parts[c].size();
+        geom.indices.insert(geom.indices.end(), parts[c].begin(), parts[c].end());
+    }
+}
+
+/* Cells along the longest side of a boundary, at a level of detail */
+size_t
+level_resolution(size_t level)
+{
+    return size_t(1024) >> (2*level);
+}
+
+} // namespace
+
+MeshRenderer::MeshRenderer()
+    : _ready(false), _current(nullptr), _multiDraw(false),
+      _transparency(false), _target(TARGETS_VIEW), _pointBuffer(0),
+      _format(FORMAT_FLOAT), _quantize(false), _blockBuffer(0),
+      _blockTexture(0), _quantizationError(0.0f),
+      _culling(true), _minChunkPixels(1.0f)
+{
+    ZoneProgram none = { 0, -1, -1 };
+    for (size_t f = 0; f < FORMAT_COUNT; f++)
+        for (size_t p = 0; p < PASS_COUNT; p++)
+            _programs[f][p] = _multiDrawPrograms[f][p] = none;
+    _compositeProgram = none;
+    
+    for (size_t k = 0; k < KIND_COUNT; k++)
+    {
+        _faces[k].buffer = _edges[k].buffer = 0;
+        _faces[k].used = _edges[k].used = 0;
+        _faces[k].capacity = _edges[k].capacity = 0;
+        
+        for (auto& batches : _batches[k])
+            for (auto& batch : batches)
+                batch.buffer = 0;
+        
+        _styles[k].buffer = 0;
+    }
+    
+    for (auto& t : _targets)
+    {
+        t.framebuffer = 0;
+        t.accumulation = t.revealage = 0;
+        t.depth = 0;
+        t.width = t.height = 0;
+    }
+}
+
+bool
+MeshRenderer::initialize(const GLFunctions::Resolver& resolver)
+{
+    if (_ready)
+        return true;
+    
+    if ( !_gl.resolve(resolver) )
+    {
+        std::cout << "OpenGL 3.1 is required to draw meshes" << std::endl;
+        return false;
+    }
+    
+    if ( !build_program(_programs[FORMAT_FLOAT][PASS_OPAQUE],
+                        { base_header, float_position_source, vertex_source },
+                        { base_header, uniform_color_source,
+                          opaque_output_source }) )
+        return false;
+    
+    _ready = true;
+    
+    /* Weighted blending needs a blend function per draw buffer */
+    bool weighted = _gl.versionAtLeast(4, 0) && _gl.BlendFunci;
+    bool multidraw = _gl.versionAtLeast(4, 3) &&
+                     _gl.MultiDrawElementsIndirect && _gl.BindBufferBase &&
+                     _gl.hasExtension("GL_ARB_shader_draw_parameters");
+    
+    for (size_t p = 0; p < PASS_COUNT; p++)
+    {
+        const char *output = (p == PASS_OPAQUE) ? opaque_output_source :
+                                                  weighted_output_source;
+        
+        if (p == PASS_TRANSPARENT && !weighted)
+            break;
+        
+        if (p != PASS_OPAQUE)
+            build_program(_programs[FORMAT_FLOAT][p],
+                          { base_header, float_position_source,
+                            vertex_source },
+                          { base_header, uniform_color_source, output });
+        
+        build_program(_programs[FORMAT_QUANTIZED][p],
+                      { glsl140_header, quantized_position_source,
+                        vertex_source },
+                      { glsl140_header, uniform_color_source, output });
+        
+        if (!multidraw)
+            continue;
+        
+        build_program(_multiDrawPrograms[FORMAT_FLOAT][p],
+                      { multidraw_header, float_position_source,
+                        multidraw_vertex_source },
+                      { multidraw_header, multidraw_color_source, output });
+        build_program(_multiDrawPrograms[FORMAT_QUANTIZED][p],
+                      { multidraw_header, quantized_position_source,
+                        multidraw_vertex_source },
+                      { multidraw_header, multidraw_color_source, output });
+    }
+    
+    if (weighted)
+        build_program(_compositeProgram,
+                      { glsl140_header, composite_vertex_source },
+                      { glsl140_header, composite_fragment_source });
+    
+    _multiDraw = (_multiDrawPrograms[FORMAT_FLOAT][PASS_OPAQUE].program != 0);
+    if (!_multiDraw)
+        std::cout << "Multi-draw-indirect not available, zones are drawn "
+                     "one by one" << std::endl;
+    
+    _transparency = (_programs[FORMAT_FLOAT][PASS_TRANSPARENT].program != 0 &&
+                     _compositeProgram.program != 0);
+    if (!_transparency)
+        std::cout << "Order-independent transparency not available, "
+                     "translucent zones are blended in drawing order"
+                  << std::endl;
+    
+    return true;
+}
+
+bool
+MeshRenderer::build_program(ZoneProgram& zp, const ShaderSources& vertex,
+                            const ShaderSources& fragment)
+{
+    GLuint vs = compile_shader(_gl, GL_VERTEX_SHADER, vertex.begin(),
+                               vertex.size());
+    GLuint fs = compile_shader(_gl, GL_FRAGMENT_SHADER, fragment.begin(),
+                               fragment.size());
+    
+    if (!vs || !fs)
+    {
+        if (vs) _gl.DeleteShader(vs);
+        if (fs) _gl.DeleteShader(fs);
+        return false;
+    }
+    
+    GLuint program = _gl.CreateProgram();
+    _gl.AttachShader(program, vs);
+    _gl.AttachShader(program, fs);
+    _gl.BindAttribLocation(program, 0, "position");
+    _gl.BindAttribLocation(program, 1, "block");
+    _gl.LinkProgram(program);
+    
+    /* The program keeps them alive as long as it needs them */
+    _gl.DeleteShader(vs);
+    _gl.DeleteShader(fs);
+    
+    GLint status;
+    _gl.GetProgramiv(program, GL_LINK_STATUS, &status);
+    if (!status)
+    {
+        char log[1024];
+        _gl.GetProgramInfoLog(program, sizeof(log), nullptr, log);
+        std::cout << "Shader program link failed: " << log << std::endl;
+        _gl.DeleteProgram(program);
+        return false;
+    }
+    
+    zp.program = program;
+    zp.colorLocation = _gl.GetUniformLocation(program, "color");
+    zp.transformLocation = _gl.GetUniformLocation(program, "transform");
+    
+    _gl.UseProgram(program);
+    for (auto& sampler : sampler_units)
+    {
+        GLint location = _gl.GetUniformLocation(program, sampler.name);
+        if (location >= 0)
+            _gl.Uniform1i(location, sampler.unit);
+    }
+    _gl.UseProgram(0);
+    
+    return true;
+}
+
+/* Programs of quantized points take the transformation as a uniform */
+void
+MeshRenderer::use_program(const ZoneProgram& zp)
+{
+    _gl.UseProgram(zp.program);
+    
+    if (zp.transformLocation >= 0)
+        _gl.UniformMatrix4fv(zp.transformLocation, 1, GL_FALSE,
+                             _viewProjection);
+    
+    _current = &zp;
+}
+
+size_t
+MeshRenderer::arena_append(IndexArena& arena, const uint32_t *indices,
+                           size_t count)
+{
+    if (arena.used + count > arena.capacity)
+    {
+        size_t capacity = std::max(2*arena.capacity, arena.used + count);
+        GLuint buffer;
+        
+        _gl.GenBuffers(1, &buffer);
+        _gl.BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        _gl.BufferData(GL_COPY_WRITE_BUFFER, capacity*sizeof(uint32_t),
+                       nullptr, GL_STATIC_DRAW);
+        
+        if (arena.buffer)
+        {
+            _gl.BindBuffer(GL_COPY_READ_BUFFER, arena.buffer);
+            _gl.CopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                  0, 0, arena.used*sizeof(uint32_t));
+            _gl.BindBuffer(GL_COPY_READ_BUFFER, 0);
+            _gl.DeleteBuffers(1, &arena.buffer);
+        }
+        
+        _gl.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        arena.buffer = buffer;
+        arena.capacity = capacity;
+    }
+    
+    size_t first = arena.used;
+    
+    _gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.buffer);
+    _gl.BufferSubData(GL_ELEMENT_ARRAY_BUFFER, first*sizeof(uint32_t),
+                      count*sizeof(uint32_t), indices);
+    _gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    
+    arena.used += count;
+    return first;
+}
+
+void
+MeshRenderer::arena_clear(IndexArena& arena)
+{
+    if (arena.buffer)
+        _gl.DeleteBuffers(1, &arena.buffer);
+    
+    arena.buffer = 0;
+    arena.used = arena.capacity = 0;
+    for (auto& ranges : arena.ranges)
+        ranges.clear();
+    arena.chunks.clear();
+}
+
+void
+MeshRenderer::setMesh(NetgenNeutralMesh& nnm)
+{
+    if (!_ready)
+        return;
+    
+    clearMesh();
+    
+    uploadPoints( nnm.points() );
+    
+    ZoneRange none = {};    /* all zero, not valid */
+    size_t nzones[KIND_COUNT] = {
+        nnm.boundaries().size(), nnm.domains().size(), nnm.domains().size()
+    };
+    
+    for (size_t k = 0; k < KIND_COUNT; k++)
+    {
+        for (size_t l = 0; l < LOD_LEVELS; l++)
+        {
+            _faces[k].ranges[l].assign(nzones[k], none);
+            _edges[k].ranges[l].assign(nzones[k], none);
+        }
+        
+        _styles[k].colors.assign(4*nzones[k], 0.0f);
+    }
+}
+
+bool
+MeshRenderer::setQuantized(bool quantize)
+{
+    if ( quantize && !_programs[FORMAT_QUANTIZED][PASS_OPAQUE].program )
+    {
+        std::cout << "Quantized vertices need OpenGL 3.1 shaders, "
+                     "points stay in floating point" << std::endl;
+        quantize = false;
+    }
+    
+    _quantize = quantize;
+    return _quantize;
+}
+
+void
+MeshRenderer::delete_points(void)
+{
+    if (_pointBuffer)
+        _gl.DeleteBuffers(1, &_pointBuffer);
+    if (_blockBuffer)
+        _gl.DeleteBuffers(1, &_blockBuffer);
+    if (_blockTexture)
+        glDeleteTextures(1, &_blockTexture);
+    
+    _pointBuffer = _blockBuffer = _blockTexture = 0;
+    _format = FORMAT_FLOAT;
+    _quantizationError = 0.0f;
+}
+
+void
+MeshRenderer::uploadPoints(const PointStore& points)
+{
+    if (!_ready)
+        return;
+    
+    delete_points();
+    
+    _gl.GenBuffers(1, &_pointBuffer);
+    _gl.BindBuffer(GL_ARRAY_BUFFER, _pointBuffer);
+    
+    std::vector<GLshort> q;
+    std::vector<GLfloat> blocks;
+    
+    if ( _quantize &&
+         !quantize_points(points.render(), points.size(),
+                          _gl.versionAtLeast(4, 2), q, blocks,
+                          _quantizationError) )
+    {
+        std::cout << "Too many points to quantize, "
+                     "points stay in floating point" << std::endl;
+        _quantize = false;
+    }
+    
+    if (!_quantize)
+    {
+        _gl.BufferData(GL_ARRAY_BUFFER, 3*points.size()*sizeof(GLfloat),
+                       points.render(), GL_STATIC_DRAW);
+        _gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+        return;
+    }
+    
+    _format = FORMAT_QUANTIZED;
+    
+    _gl.BufferData(GL_ARRAY_BUFFER, q.size()*sizeof(GLshort), q.data(),
+                   GL_STATIC_DRAW);
+    _gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    _gl.GenBuffers(1, &_blockBuffer);
+    _gl.BindBuffer(GL_TEXTURE_BUFFER, _blockBuffer);
+    _gl.BufferData(GL_TEXTURE_BUFFER, blocks.size()*sizeof(GLfloat),
+                   blocks.data(), GL_STATIC_DRAW);
+    _gl.BindBuffer(GL_TEXTURE_BUFFER, 0);
+    
+    glGenTextures(1, &_blockTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, _blockTexture);
+    _gl.TexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, _blockBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void
+MeshRenderer::clearMesh(void)
+{
+    if (!_ready)
+        return;
+    
+    delete_points();
+    
+    for (size_t k = 0; k < KIND_COUNT; k++)
+    {
+        arena_clear(_faces[k]);
+        arena_clear(_edges[k]);
+        
+        for (auto& batches : _batches[k])
+            for (auto& batch : batches)
+            {
+                if (batch.buffer)
+                    _gl.DeleteBuffers(1, &batch.buffer);
+                
+                batch.buffer = 0;
+                batch.commands.clear();
+            }
+        
+        if (_styles[k].buffer)
+            _gl.DeleteBuffers(1, &_styles[k].buffer);
+        
+        _styles[k].buffer = 0;
+        _styles[k].colors.clear();
+    }
+}
+
+void
+MeshRenderer::buildZone(NetgenNeutralMesh& nnm, ZoneGeometry& geom)
+{
+    const GLfloat *xyz = nnm.points().render();
+    
+    geom.indices.clear();
+    geom.chunks.clear();
+    
+    switch (geom.kind)
+    {
+        case KIND_BOUNDARIES:
+        {
+            const Boundary& b = nnm.boundaries().zone(geom.slot);
+            
+            if (geom.level == 0)
+            {
+                build_chunks(xyz, b.data(), b.size(), geom);
+                break;
+            }
+            
+            std::vector<Triangle> proxy =
+                cluster_triangles(nnm.points(), b.data(), b.size(),
+                                  level_resolution(geom.level));
+            build_chunks(xyz, proxy.data(), proxy.size(), geom);
+            break;
+        }
+        
+        /* A domain owns the edges on its sides too, whether the domain
+         * next to it is displayed or not */
+        case KIND_DOMAINS:
+        {
+            const Domain& d = nnm.domains().zone(geom.slot);
+            build_chunks(xyz, d.data(), d.size(), geom);
+            break;
+        }
+        
+        case KIND_SHELLS:
+        {
+            FaceTable faces = nnm.topology().shell(geom.slot);
+            build_chunks(xyz, faces->data(), faces->size(), geom);
+            break;
+        }
+        
+        default:
+            break;
+    }
+}
+
+bool
+MeshRenderer::uploadZone(const ZoneGeometry& geom)
+{
+    IndexArena& arena = geom.edges ? _edges[geom.kind] : _faces[geom.kind];
+    
+    if ( !_ready || geom.level >= LOD_LEVELS ||
+         geom.slot >= arena.ranges[geom.level].size() )
+        return false;
+    
+    ZoneRange r;
+    r.first = arena_append(arena, geom.indices.data(), geom.indices.size());
+    r.count = geom.indices.size();
+    r.firstChunk = arena.chunks.size();
+    r.chunkCount = geom.chunks.size();
+    r.valid = true;
+    
+    for (size_t i = 0; i < 3; i++)
+    {
+        r.min[i] = std::numeric_limits<GLfloat>::max();
+        r.max[i] = -std::numeric_limits<GLfloat>::max();
+    }
+    
+    for (auto chunk : geom.chunks)
+    {
+        for (size_t i = 0; i < 3; i++)
+        {
+            r.min[i] = std::min(r.min[i], chunk.min[i]);
+            r.max[i] = std::max(r.max[i], chunk.max[i]);
+        }
+        
+        chunk.first += r.first;
+        arena.chunks.push_back(chunk);
+    }
+    
+    arena.ranges[geom.level][geom.slot] = r;
+    return true;
+}
+
+bool
+MeshRenderer::hasZone(ZoneKind kind, size_t slot, bool edges,
+                      size_t level) const
+{
+    const IndexArena& arena = edges ? _edges[kind] : _faces[kind];
+    
+    return level < LOD_LEVELS && slot < arena.ranges[level].size() &&
+           arena.ranges[level][slot].valid;
+}
+
+bool
+MeshRenderer::hasZone(ZoneKind kind, size_t slot, bool edges) const
+{
+    for (size_t l = 0; l < LOD_LEVELS; l++)
+        if ( hasZone(kind, slot, edges, l) )
+            return true;
+    
+    return false;
+}
+
+/* Until some geometry of the zone tells how big it is, the coarsest
+ * level is the one to build first */
+size_t
+MeshRenderer::pickLevel(ZoneKind kind, size_t slot, bool edges) const
+{
+    if (kind != KIND_BOUNDARIES)
+        return 0;
+    
+    const IndexArena& arena = edges ? _edges[kind] : _faces[kind];
+    
+    for (size_t l = 0; l < LOD_LEVELS; l++)
+    {
+        if ( !hasZone(kind, slot, edges, l) )
+            continue;
+        
+        const ZoneRange& r = arena.ranges[l][slot];
+        GLfloat pixels;
+        
+        if ( !box_visible(r.min, r.max, pixels) )
+            return LOD_LEVELS-1;
+        
+        /* A proxy can collapse entirely when the zone is small */
+        for (size_t level = LOD_LEVELS-1; level > 0; level--)
+            if ( pixels <= level_resolution(level)*LOD_CELL_PIXELS &&
+                 !(hasZone(kind, slot, edges, level) &&
+                   arena.ranges[level][slot].count == 0) )
+                return level;
+        
+        return 0;
+    }
+    
+    return LOD_LEVELS-1;
+}
+
+void
+MeshRenderer::addPreview(GLenum mode, const GLfloat *xyz, size_t nvertices)
+{
+    if (!_ready)
+        return;
+    
+    PreviewBuffer pb;
+    pb.count = nvertices;
+    
+    _gl.GenBuffers(1, &pb.buffer);
+    _gl.BindBuffer(GL_ARRAY_BUFFER, pb.buffer);
+    _gl.BufferData(GL_ARRAY_BUFFER, 3*nvertices*sizeof(GLfloat), xyz,
+                   GL_STATIC_DRAW);
+    _gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    if (mode == GL_TRIANGLES)
+        _previewTriangles.push_back(pb);
+    else
+        _previewPoints.push_back(pb);
+}
+
+void
+MeshRenderer::delete_preview(std::vector<PreviewBuffer>& buffers)
+{
+    for (auto& pb : buffers)
+        _gl.DeleteBuffers(1, &pb.buffer);
+    
+    buffers.clear();
+}
+
+void
+MeshRenderer::clearPreview(void)
+{
+    if (!_ready)
+        return;
+    
+    delete_preview(_previewPoints);
+    delete_preview(_previewTriangles);
+}
+
+void
+MeshRenderer::bind_points(GLuint buffer, VertexFormat format)
+{
+    _gl.BindBuffer(GL_ARRAY_BUFFER, buffer);
+    
+    /* The block of a quantized point follows its coordinates */
+    if (format == FORMAT_QUANTIZED)
+    {
+        GLsizei stride = 4*sizeof(GLshort);
+        _gl.VertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, stride, nullptr);
+        _gl.VertexAttribPointer(1, 1, GL_UNSIGNED_SHORT, GL_FALSE, stride,
+                                (const GLvoid *)(3*sizeof(GLshort)));
+        _gl.EnableVertexAttribArray(1);
+    }
+    else
+    {
+        _gl.VertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+        _gl.DisableVertexAttribArray(1);
+    }
+}
+
+void
+MeshRenderer::begin(void)
+{
+    if (!_ready)
+        return;
+    
+    GLfloat projection[16], modelview[16];
+    glGetFloatv(GL_PROJECTION_MATRIX, projection);
+    glGetFloatv(GL_MODELVIEW_MATRIX, modelview);
+    glGetIntegerv(GL_VIEWPORT, _viewport);
+    
+    /* Column major, as GL keeps them */
+    for (size_t c = 0; c < 4; c++)
+        for (size_t r = 0; r < 4; r++)
+        {
+            GLfloat sum = 0;
+            for (size_t k = 0; k < 4; k++)
+                sum += projection[4*k + r] * modelview[4*c + k];
+            
+            _viewProjection[4*c + r] = sum;
+        }
+    
+    /* Previews are in floating point, and drawn instead of the mesh */
+    VertexFormat format = hasPreview() ? FORMAT_FLOAT : _format;
+    
+    use_program(_programs[format][PASS_OPAQUE]);
+    _gl.EnableVertexAttribArray(0);
+    bind_points(_pointBuffer, format);
+    
+    if (format == FORMAT_QUANTIZED)
+        glBindTexture(GL_TEXTURE_BUFFER, _blockTexture);
+}
+
+void
+MeshRenderer::setCulling(bool enabled, GLfloat minPixels)
+{
+    _culling = enabled;
+    _minChunkPixels = minPixels;
+}
+
+/* A box is out of view when all its corners are on the outer side of
+ * the same clip plane. Its size on screen is the larger side of its
+ * projection, in pixels, or infinite when it is partly behind the eye. */
+bool
+MeshRenderer::box_visible(const GLfloat *min, const GLfloat *max,
+                          GLfloat& pixels) const
+{
+    int outside[6] = { 0, 0, 0, 0, 0, 0 };
+    GLfloat ndc_min[2] = {  2,  2 };
+    GLfloat ndc_max[2] = { -2, -2 };
+    bool projected = true;
+    
+    for (size_t corner = 0; corner < 8; corner++)
+    {
+        GLfloat p[3] = {
+            (corner & 1) ? max[0] : min[0],
+            (corner & 2) ? max[1] : min[1],
+            (corner & 4) ? max[2] : min[2]
+        };
+        
+        GLfloat clip[4];
+        for (size_t r = 0; r < 4; r++)
+            clip[r] = _viewProjection[r]*p[0] + _viewProjection[4+r]*p[1] +
+                      _viewProjection[8+r]*p[2] + _viewProjection[12+r];
+        
+        for (size_t i = 0; i < 3; i++)
+        {
+            outside[2*i] += (clip[i] < -clip[3]);
+            outside[2*i+1] += (clip[i] > clip[3]);
+        }
+        
+        if (clip[3] <= 0)
+        {
+            projected = false;
+            continue;
+        }
+        
+        for (size_t i = 0; i < 2; i++)
+        {
+            ndc_min[i] = std::min(ndc_min[i], clip[i]/clip[3]);
+            ndc_max[i] = std::max(ndc_max[i], clip[i]/clip[3]);
+        }
+    }
+    
+    pixels = std::numeric_limits<GLfloat>::max();
+    
+    for (size_t plane = 0; plane < 6; plane++)
+        if (outside[plane] == 8)
+            return false;
+    
+    if (projected)
+        pixels = std::max((ndc_max[0] - ndc_min[0]) * _viewport[2]/2,
+                          (ndc_max[1] - ndc_min[1]) * _viewport[3]/2);
+    
+    return true;
+}
+
+/* The requested level if it is there, otherwise the nearest one,
+ * the coarser first */
+bool
+MeshRenderer::draw_level(const IndexArena& arena, const ZoneDraw& d,
+                         size_t& level) const
+{
+    for (size_t dist = 0; dist < LOD_LEVELS; dist++)
+    {
+        size_t candidates[2] = { d.level + dist, d.level - dist };
+        
+        for (auto l : candidates)
+            if ( l < LOD_LEVELS && d.slot < arena.ranges[l].size() &&
+                 arena.ranges[l][d.slot].valid )
+            {
+                level = l;
+                return true;
+            }
+    }
+    
+    return false;
+}
+
+/* Index ranges of the visible chunks of a zone, merging neighbours */
+void
+MeshRenderer::visible_runs(const IndexArena& arena, size_t slot, size_t level,
+                           std::vector<std::pair<size_t, size_t>>& runs) const
+{
+    runs.clear();
+    
+    const ZoneRange& r = arena.ranges[level][slot];
+    
+    if (!_culling)
+    {
+        runs.push_back( std::make_pair(r.first, r.count) );
+        return;
+    }
+    
+    for (size_t c = r.firstChunk; c < r.firstChunk + r.chunkCount; c++)
+    {
+        const ZoneChunk& chunk = arena.chunks[c];
+        GLfloat pixels;
+        
+        if ( !box_visible(chunk.min, chunk.max, pixels) ||
+             pixels < _minChunkPixels )
+            continue;
+        
+        if ( !runs.empty() &&
+             runs.back().first + runs.back().second == chunk.first )
+            runs.back().second += chunk.count;
+        else
+            runs.push_back( std::make_pair(chunk.first, chunk.count) );
+    }
+}
+
+void
+MeshRenderer::setColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+    if (_ready && _current)
+        _gl.Uniform4f(_current->colorLocation, r, g, b, a);
+}
+
+/* Opaque zones first; the translucent ones go through weighted
+ * blending if possible, otherwise they are blended as they come,
+ * without hiding what is behind them */
+void
+MeshRenderer::drawZones(ZoneKind kind, bool edges,
+                        const std::vector<ZoneDraw>& draws)
+{
+    if (!_ready || draws.empty())
+        return;
+    
+    std::vector<ZoneDraw> opaque, translucent;
+    for (auto& d : draws)
+    {
+        if (d.color[3] > 0)
+            translucent.push_back(d);
+        else
+            opaque.push_back(d);
+    }
+    
+    draw_batch(kind, edges, opaque, PASS_OPAQUE);
+    
+    if ( translucent.empty() )
+        return;
+    
+    if ( _transparency && _programs[_format][PASS_TRANSPARENT].program &&
+         resize_targets() )
+    {
+        draw_transparent(kind, edges, opaque, translucent);
+        return;
+    }
+    
+    glPushAttrib(GL_DEPTH_BUFFER_BIT);
+    glDepthMask(GL_FALSE);
+    draw_batch(kind, edges, translucent, PASS_OPAQUE);
+    glPopAttrib();
+}
+
+/* Translucent zones add up in the accumulation and revealage targets
+ * whatever their order, behind the depth of the opaque zones drawn
+ * again there; the result is composited over the frame. */
+void
+MeshRenderer::draw_transparent(ZoneKind kind, bool edges,
+                               const std::vector<ZoneDraw>& opaque,
+                               const std::vector<ZoneDraw>& translucent)
+{
+    static const GLfloat clear_accumulation[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    static const GLfloat clear_revealage[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    
+    const TransparencyTargets& t = _targets[_target];
+    const ZoneProgram *previous = _current;
+    GLint frame;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &frame);
+    
+    glPushAttrib(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
+                 GL_ENABLE_BIT | GL_POLYGON_BIT);
+    
+    _gl.BindFramebuffer(GL_FRAMEBUFFER, t.framebuffer);
+    _gl.ClearBufferfv(GL_COLOR, 0, clear_accumulation);
+    _gl.ClearBufferfv(GL_COLOR, 1, clear_revealage);
+    
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    draw_batch(kind, edges, opaque, PASS_OPAQUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    
+    glDepthMask(GL_FALSE);
+    glEnable(GL_BLEND);
+    _gl.BlendFunci(0, GL_ONE, GL_ONE);
+    _gl.BlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    draw_batch(kind, edges, translucent, PASS_TRANSPARENT);
+    
+    _gl.BindFramebuffer(GL_FRAMEBUFFER, frame);
+    
+    glDisable(GL_DEPTH_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+    
+    _gl.UseProgram(_compositeProgram.program);
+    _gl.ActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, t.revealage);
+    _gl.ActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, t.accumulation);
+    
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    
+    glBindTexture(GL_TEXTURE_2D, 0);
+    _gl.ActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    _gl.ActiveTexture(GL_TEXTURE0);
+    
+    glPopAttrib();
+    use_program(*previous);
+}
+
+/* Targets as large as the viewport, made again when it grows or
+ * shrinks */
+bool
+MeshRenderer::resize_targets(void)
+{
+    TransparencyTargets& t = _targets[_target];
+    GLsizei width = _viewport[0] + _viewport[2];
+    GLsizei height = _viewport[1] + _viewport[3];
+    
+    if (width == t.width && height == t.height)
+        return t.framebuffer != 0;
+    
+    release_targets(t);
+    t.width = width;
+    t.height = height;
+    
+    if (width <= 0 || height <= 0)
+        return false;
+    
+    GLuint textures[2];
+    glGenTextures(2, textures);
+    t.accumulation = textures[0];
+    t.revealage = textures[1];
+    
+    glBindTexture(GL_TEXTURE_2D, t.accumulation);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA,
+                 GL_HALF_FLOAT, nullptr);
+    
+    glBindTexture(GL_TEXTURE_2D, t.revealage);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED,
+                 GL_UNSIGNED_BYTE, nullptr);
+    
+    glBindTexture(GL_TEXTURE_2D, 0);
+    
+    _gl.GenRenderbuffers(1, &t.depth);
+    _gl.BindRenderbuffer(GL_RENDERBUFFER, t.depth);
+    _gl.RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+                            width, height);
+    _gl.BindRenderbuffer(GL_RENDERBUFFER, 0);
+    
+    GLint frame;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &frame);
+    
+    static const GLenum buffers[2] = {
+        GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1
+    };
+    
+    _gl.GenFramebuffers(1, &t.framebuffer);
+    _gl.BindFramebuffer(GL_FRAMEBUFFER, t.framebuffer);
+    _gl.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                             GL_TEXTURE_2D, t.accumulation, 0);
+    _gl.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+                             GL_TEXTURE_2D, t.revealage, 0);
+    _gl.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                                GL_RENDERBUFFER, t.depth);
+    _gl.DrawBuffers(2, buffers);
+    
+    GLenum status = _gl.CheckFramebufferStatus(GL_FRAMEBUFFER);
+    _gl.BindFramebuffer(GL_FRAMEBUFFER, frame);
+    
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Transparency targets are not supported, translucent "
+                     "zones are blended in drawing order" << std::endl;
+        release_targets(t);
+        _transparency = false;
+        return false;
+    }
+    
+    return true;
+}
+
+void
+MeshRenderer::release_targets(TransparencyTargets& t)
+{
+    if (t.framebuffer)
+        _gl.DeleteFramebuffers(1, &t.framebuffer);
+    if (t.depth)
+        _gl.DeleteRenderbuffers(1, &t.depth);
+    if (t.accumulation)
+        glDeleteTextures(1, &t.accumulation);
+    if (t.revealage)
+        glDeleteTextures(1, &t.revealage);
+    
+    t.framebuffer = t.depth = 0;
+    t.accumulation = t.revealage = 0;
+    t.width = t.height = 0;
+}
+
+void
+MeshRenderer::draw_batch(ZoneKind kind, bool edges,
+                         const std::vector<ZoneDraw>& draws, Pass pass)
+{
+    if ( draws.empty() )
+        return;
+    
+    if (_multiDrawPrograms[_format][pass].program)
+    {
+        multi_draw(kind, edges, draws, pass);
+        return;
+    }
+    
+    if (_current != &_programs[_format][pass])
+        use_program(_programs[_format][pass]);
+    
+    const IndexArena& arena = edges ? _edges[kind] : _faces[kind];
+    std::vector<std::pair<size_t, size_t>> runs;
+    
+    _gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.buffer);
+    
+    for (auto& d : draws)
+    {
+        size_t level;
+        if ( !draw_level(arena, d, level) )
+            continue;
+        
+        visible_runs(arena, d.slot, level, runs);
+        setColor(d.color[0], d.color[1], d.color[2], d.color[3]);
+        
+        for (auto& run : runs)
+            glDrawElements(edges ? GL_LINES : GL_TRIANGLES, run.second,
+                           GL_UNSIGNED_INT,
+                           (const GLvoid *)(run.first*sizeof(uint32_t)));
+    }
+}
+
+void
+MeshRenderer::multi_draw(ZoneKind kind, bool edges,
+                         const std::vector<ZoneDraw>& draws, Pass pass)
+{
+    const IndexArena& arena = edges ? _edges[kind] : _faces[kind];
+    DrawBatch& batch = _batches[kind][edges][pass];
+    StyleBuffer& styles = _styles[kind];
+    
+    std::vector<DrawCommand> commands;
+    std::vector<std::pair<size_t, size_t>> runs;
+    bool restyled = (styles.buffer == 0);
+    
+    commands.reserve(draws.size());
+    
+    for (auto& d : draws)
+    {
+        size_t level;
+        if ( !draw_level(arena, d, level) )
+            continue;
+        
+        visible_runs(arena, d.slot, level, runs);
+        
+        for (auto& run : runs)
+        {
+            DrawCommand cmd = { GLuint(run.second), 1, GLuint(run.first), 0,
+                                GLuint(d.slot) };
+            commands.push_back(cmd);
+        }
+        
+        GLfloat *color = &styles.colors[4*d.slot];
+        if ( !std::equal(d.color, d.color + 4, color) )
+        {
+            std::copy(d.color, d.color + 4, color);
+            restyled = true;
+        }
+    }
+    
+    if (restyled)
+    {
+        if (!styles.buffer)
+            _gl.GenBuffers(1, &styles.buffer);
+        
+        _gl.BindBuffer(GL_SHADER_STORAGE_BUFFER, styles.buffer);
+        _gl.BufferData(GL_SHADER_STORAGE_BUFFER,
+                       styles.colors.size()*sizeof(GLfloat),
+                       styles.colors.data(), GL_DYNAMIC_DRAW);
+        _gl.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    
+    if ( commands.empty() )
+        return;
+    
+    /* Showing or hiding zones, or moving the view, only changes the
+     * commands */
+    if ( !batch.buffer || commands.size() != batch.commands.size() ||
+         memcmp(commands.data(), batch.commands.data(),
+                commands.size()*sizeof(DrawCommand)) )
+    {
+        if (!batch.buffer)
+            _gl.GenBuffers(1, &batch.buffer);
+        
+        _gl.BindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.buffer);
+        _gl.BufferData(GL_DRAW_INDIRECT_BUFFER,
+                       commands.size()*sizeof(DrawCommand),
+                       commands.data(), GL_DYNAMIC_DRAW);
+        _gl.BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        
+        batch.commands.swap(commands);
+    }
+    
+    const ZoneProgram *previous = _current;
+    use_program(_multiDrawPrograms[_format][pass]);
+    _gl.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, styles.buffer);
+    _gl.BindBuffer(GL_DRAW_INDIRECT_BUFFER, batch.buffer);
+    _gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.buffer);
+    
+    _gl.MultiDrawElementsIndirect(edges ? GL_LINES : GL_TRIANGLES,
+                                  GL_UNSIGNED_INT, nullptr,
+                                  batch.commands.size(), 0);
+    
+    _gl.BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    _gl.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+    use_program(*previous);
+}
+
+/* Boundaries replace the point cloud as soon as there are some */
+void
+MeshRenderer::drawPreview(void)
+{
+    if (!_ready)
+        return;
+    
+    bool triangles = !_previewTriangles.empty();
+    auto& buffers = triangles ? _previewTriangles : _previewPoints;
+    
+    for (auto& pb : buffers)
+    {
+        bind_points(pb.buffer, FORMAT_FLOAT);
+        glDrawArrays(triangles ? GL_TRIANGLES : GL_POINTS, 0, pb.count);
+    }
+    
+    bind_points(_pointBuffer, FORMAT_FLOAT);
+}
+
+void
+MeshRenderer::end(void)
+{
+    if (!_ready)
+        return;
+    
+    _gl.DisableVertexAttribArray(0);
+    _gl.DisableVertexAttribArray(1);
+    _gl.BindBuffer(GL_ARRAY_BUFFER, 0);
+    _gl.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    _gl.UseProgram(0);
+    _current = nullptr;
+}
+
+void
+MeshRenderer::release(void)
+{
+    if (!_ready)
+        return;
+    
+    clearMesh();
+    clearPreview();
+    
+    for (auto& t : _targets)
+        release_targets(t);
+    
+    for (size_t f = 0; f < FORMAT_COUNT; f++)
+        for (size_t p = 0; p < PASS_COUNT; p++)
+        {
+            if (_programs[f][p].program)
+                _gl.DeleteProgram(_programs[f][p].program);
+            if (_multiDrawPrograms[f][p].program)
+                _gl.DeleteProgram(_multiDrawPrograms[f][p].program);
+            
+            _programs[f][p].program = _multiDrawPrograms[f][p].program = 0;
+        }
+    
+    if (_compositeProgram.program)
+        _gl.DeleteProgram(_compositeProgram.program);
+    _compositeProgram.program = 0;
+    
+    _multiDraw = _transparency = false;
+    
+    _ready = false;
+}
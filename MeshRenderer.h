@@ -0,0 +1,330 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <initializer_list>
+
+#include "GLFunctions.h"
+#include "Mesh.h"
+#include "Topology.h"
+
+/* Level 0 is the zone at full resolution, the others are simplified
+ * proxies of boundaries, coarser and coarser */
+#define LOD_LEVELS      4
+
+/* Most points sharing a box in the quantized vertex buffer, and the
+ * most boxes a 16 bit block index can tell apart */
+#define POINT_BLOCK         4096
+#define MAX_POINT_BLOCKS    65536
+
+/*******************************************************************/
+/* Draws a mesh from buffer objects: the normalized points are uploaded
+ * once and shared by everything, and every zone is a range of the
+ * index buffer of its kind. Boundaries and shells are indexed by their
+ * own connectivity, domains by the four faces of each tetrahedron.
+ * Every zone also has the list of its distinct edges, for wireframes
+ * that draw each edge once instead of once per face around it.
+ * The transformation is taken from the fixed-function matrices.
+ *
+ * With setQuantized() the points are uploaded as 16 bit normalized
+ * integers, relative to the box of each block of up to POINT_BLOCK
+ * points close to each other; the vertex shader looks the box up in a
+ * texture buffer by the block index stored as the fourth short of the
+ * point. That is 8 bytes per point against 12 for floats, a third less
+ * vertex traffic rather than half. quantizationError() tells how far
+ * the points move, in normalized coordinates.
+ *
+ * drawZones() draws all the given zones of a kind. With OpenGL 4.3 and
+ * ARB_shader_draw_parameters that is a single multi-draw-indirect call:
+ * the base instance of each command is the zone slot, which indexes a
+ * storage buffer of colors. Both buffers are only written again when
+ * their contents change. Otherwise zones are drawn one by one, with the
+ * color as a uniform.
+ *
+ * Translucent zones are drawn after the opaque ones with weighted
+ * blended order-independent transparency (McGuire and Bavoil): in a
+ * single pass they add up into an accumulation and a revealage target,
+ * whatever their order, and a full-screen pass composites them over the
+ * frame. That takes OpenGL 4.0 for a blend function per draw buffer;
+ * otherwise they are blended in the order given.
+ *
+ * Zones are not drawn until their geometry is uploaded. buildZone()
+ * does the work on the CPU and can run on any thread; uploadZone()
+ * appends the result to the index buffer of the zone kind, and returns
+ * false without a usable renderer or for a slot the mesh lacks. The
+ * elements of a zone are laid out in spatially coherent chunks with
+ * their bounding boxes; chunks outside the view, or smaller than a
+ * given size in pixels, are skipped at draw time.
+ *
+ * Boundaries also have levels of detail, built by vertex clustering
+ * on a grid that gets four times coarser at each level. pickLevel()
+ * chooses the coarsest one whose cells stay within LOD_CELL_PIXELS on
+ * screen, and drawZones() falls back to the nearest level available.
+ *
+ * All the other calls need the context the renderer was initialized
+ * in to be current.
+ */
+class MeshRenderer
+{
+public:
+    enum ZoneKind {
+        KIND_BOUNDARIES,
+        KIND_DOMAINS,
+        KIND_SHELLS,
+        KIND_COUNT
+    };
+    
+    /* Draws to the window, or to an offscreen frame of another size;
+     * each has its own transparency targets */
+    enum TargetSet {
+        TARGETS_VIEW,
+        TARGETS_OFFSCREEN,
+        TARGETS_COUNT
+    };
+    
+    /* A zone to draw and its color; alpha is the transparency, 0 for
+     * opaque zones */
+    struct ZoneDraw
+    {
+        size_t      slot;
+        size_t      level;
+        GLfloat     color[4];
+    };
+    
+    /* Range of indices of a zone and the box around their points */
+    struct ZoneChunk
+    {
+        size_t      first;
+        size_t      count;
+        GLfloat     min[3], max[3];
+    };
+    
+    /* Faces, or edges, of a zone ready for upload */
+    struct ZoneGeometry
+    {
+        ZoneKind                kind;
+        size_t                  slot;
+        bool                    edges;
+        size_t                  level;
+        std::vector<uint32_t>   indices;
+        std::vector<ZoneChunk>  chunks;
+    };
+    
+private:
+    /* In indices, from the start of the index buffer */
+    struct ZoneRange
+    {
+        size_t      first;
+        size_t      count;
+        size_t      firstChunk;
+        size_t      chunkCount;
+        GLfloat     min[3], max[3];
+        bool        valid;
+    };
+    
+    /* Index buffer that zones get appended to; it grows by copying
+     * to a larger one on the GPU */
+    struct IndexArena
+    {
+        GLuint                  buffer;
+        size_t                  used, capacity;
+        std::vector<ZoneRange>  ranges[LOD_LEVELS];
+        std::vector<ZoneChunk>  chunks;
+    };
+    
+    /* Layout fixed by glMultiDrawElementsIndirect */
+    struct DrawCommand
+    {
+        GLuint      count;
+        GLuint      instanceCount;
+        GLuint      firstIndex;
+        GLint       baseVertex;
+        GLuint      baseInstance;
+    };
+    
+    struct DrawBatch
+    {
+        GLuint                      buffer;
+        std::vector<DrawCommand>    commands;
+    };
+    
+    /* One vec4 per zone slot */
+    struct StyleBuffer
+    {
+        GLuint                  buffer;
+        std::vector<GLfloat>    colors;
+    };
+    
+    struct PreviewBuffer
+    {
+        GLuint      buffer;
+        GLsizei     count;
+    };
+    
+    enum VertexFormat {
+        FORMAT_FLOAT,
+        FORMAT_QUANTIZED,
+        FORMAT_COUNT
+    };
+    
+    /* Translucent zones have their own fragment shaders */
+    enum Pass {
+        PASS_OPAQUE,
+        PASS_TRANSPARENT,
+        PASS_COUNT
+    };
+    
+    struct ZoneProgram
+    {
+        GLuint      program;
+        GLint       colorLocation;
+        GLint       transformLocation;
+    };
+    
+    typedef std::initializer_list<const char *>     ShaderSources;
+    
+    /* Weighted blending targets, as large as the viewport */
+    struct TransparencyTargets
+    {
+        GLuint      framebuffer;
+        GLuint      accumulation, revealage;
+        GLuint      depth;
+        GLsizei     width, height;
+    };
+    
+    GLFunctions                 _gl;
+    bool                        _ready;
+    ZoneProgram                 _programs[FORMAT_COUNT][PASS_COUNT];
+    ZoneProgram                 _multiDrawPrograms[FORMAT_COUNT][PASS_COUNT];
+    ZoneProgram                 _compositeProgram;
+    const ZoneProgram           *_current;
+    bool                        _multiDraw;
+    bool                        _transparency;
+    TransparencyTargets         _targets[TARGETS_COUNT];
+    TargetSet                   _target;
+    
+    GLuint                      _pointBuffer;
+    VertexFormat                _format;
+    bool                        _quantize;
+    GLuint                      _blockBuffer, _blockTexture;
+    GLfloat                     _quantizationError;
+    
+    IndexArena                  _faces[KIND_COUNT];
+    IndexArena                  _edges[KIND_COUNT];
+    
+    /* Faces or edges, by pass */
+    DrawBatch                   _batches[KIND_COUNT][2][PASS_COUNT];
+    StyleBuffer                 _styles[KIND_COUNT];
+    
+    /* Taken from the GL state by begin() */
+    GLfloat                     _viewProjection[16];
+    GLint                       _viewport[4];
+    bool                        _culling;
+    GLfloat                     _minChunkPixels;
+    
+    /* Geometry of a mesh still being loaded, one buffer per chunk */
+    std::vector<PreviewBuffer>  _previewPoints, _previewTriangles;
+    
+    bool    build_program(ZoneProgram&, const ShaderSources&,
+                          const ShaderSources&);
+    void    use_program(const ZoneProgram&);
+    size_t  arena_append(IndexArena&, const uint32_t *, size_t);
+    void    arena_clear(IndexArena&);
+    bool    box_visible(const GLfloat *, const GLfloat *, GLfloat&) const;
+    bool    draw_level(const IndexArena&, const ZoneDraw&, size_t&) const;
+    void    visible_runs(const IndexArena&, size_t, size_t,
+                         std::vector<std::pair<size_t, size_t>>&) const;
+    void    draw_batch(ZoneKind, bool, const std::vector<ZoneDraw>&, Pass);
+    void    multi_draw(ZoneKind, bool, const std::vector<ZoneDraw>&, Pass);
+    void    draw_transparent(ZoneKind, bool, const std::vector<ZoneDraw>&,
+                             const std::vector<ZoneDraw>&);
+    bool    resize_targets(void);
+    void    release_targets(TransparencyTargets&);
+    void    bind_points(GLuint, VertexFormat);
+    void    delete_points(void);
+    void    delete_preview(std::vector<PreviewBuffer>&);
+    
+public:
+    MeshRenderer();
+    
+    /* Looks up the entry points and compiles the shaders */
+    bool    initialize(const GLFunctions::Resolver&);
+    bool    ready(void) const { return _ready; }
+    bool    multiDraw(void) const { return _multiDraw; }
+    
+    /* Culling of chunks outside the view and smaller than the given
+     * size in pixels; on by default */
+    void    setCulling(bool, GLfloat);
+    
+    const GLFunctions&  functions(void) const { return _gl; }
+    
+    /* Uploads the points; zones are uploaded one by one afterwards */
+    void    setMesh(NetgenNeutralMesh&);
+    void    clearMesh(void);
+    
+    /* Vertex format for the next points uploaded; uploadPoints() can
+     * replace the points of the current mesh, zones stay valid */
+    bool    setQuantized(bool);
+    bool    quantized(void) const { return _format == FORMAT_QUANTIZED; }
+    void    uploadPoints(const PointStore&);
+    GLfloat quantizationError(void) const { return _quantizationError; }
+    
+    static void buildZone(NetgenNeutralMesh&, ZoneGeometry&);
+    bool        uploadZone(const ZoneGeometry&);
+    
+    /* At the given level, or at any level */
+    bool        hasZone(ZoneKind, size_t, bool, size_t) const;
+    bool        hasZone(ZoneKind, size_t, bool) const;
+    
+    /* Level for the current view, between begin() and end() */
+    size_t      pickLevel(ZoneKind, size_t, bool) const;
+    
+    /* Vertices of points (GL_POINTS) or triangles (GL_TRIANGLES) */
+    void    addPreview(GLenum, const GLfloat *, size_t);
+    bool    hasPreview(void) const { return !_previewPoints.empty(); }
+    void    clearPreview(void);
+    
+    /* Transparency targets of the draws that follow; the ones of a set
+     * are kept until released, or until the size of the frame changes */
+    void    useTargets(TargetSet set) { _target = set; }
+    void    releaseTargets(TargetSet set) { release_targets(_targets[set]); }
+    
+    /* Drawing happens between begin() and end() */
+    void    begin(void);
+    void    setColor(GLfloat, GLfloat, GLfloat, GLfloat);
+    void    drawZones(ZoneKind, bool, const std::vector<ZoneDraw>&);
+    void    drawPreview(void);
+    void    end(void);
+    
+    /* Deletes all the GL objects */
+    void    release(void);
+};
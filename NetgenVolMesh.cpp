@@ -0,0 +1,248 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <limits>
+
+#include "NetgenVolMesh.h"
+
+/* Records between two progress reports */
+#define PROGRESS_RECORDS    16384
+
+/* Points the elements can index; the ones actually read are checked
+ * once all the sections are in */
+#define MAX_POINTS  size_t(std::numeric_limits<Triangle::index_type>::max())
+
+static bool
+keyword_is(const char *word, size_t len, const char *keyword)
+{
+    return strlen(keyword) == len && strncmp(word, keyword, len) == 0;
+}
+
+/*****************************************************************************/
+NetgenVolMesh::NetgenVolMesh()
+    : _skipped(0)
+{}
+
+/* surfnr bcnr domin domout np p1 ... pnp [geometry info], one per line.
+ * Second order elements list their vertices first, quads are split.
+ */
+bool
+NetgenVolMesh::read_surface_elements(TextScanner& scanner, bool verbose)
+{
+    size_t n_items, surfnr, bcnr, domin, domout, np, p[4];
+    
+    if (verbose)
+    {
+        std::cout << "Loading boundary triangles...";
+        std::cout.flush();
+    }
+    
+    if ( !scanner.read_size(n_items) )
+        return false;
+    
+    _triList.reserve(_triList.size() + n_items);
+    
+    while (n_items--)
+    {
+        if ( (n_items % PROGRESS_RECORDS) == 0 &&
+             !report_progress(scanner.offset()) )
+            return false;
+        
+        if ( !scanner.read_size(surfnr) || !scanner.read_size(bcnr) ||
+             !scanner.read_size(domin) || !scanner.read_size(domout) ||
+             !scanner.read_size(np) )
+            return false;
+        
+        size_t nv = (np == 4 || np == 8) ? 4 : 3;
+        
+        if ( np < 3 || np == 5 || np == 7 || np > 8 )
+        {
+            _skipped++;
+            scanner.skip_line();
+            continue;
+        }
+        
+        for (size_t i = 0; i < nv; i++)
+            if ( !scanner.read_size(p[i]) || !point_in_range(p[i], MAX_POINTS) )
+                return false;
+        
+        _triList.add(bcnr, Triangle(p[0]-1, p[1]-1, p[2]-1));
+        if (nv == 4)
+            _triList.add(bcnr, Triangle(p[0]-1, p[2]-1, p[3]-1));
+        
+        scanner.skip_line();
+    }
+    
+    if (verbose)
+        std::cout << "done" << std::endl;
+    
+    return true;
+}
+
+/* matnr np p1 ... pnp, one per line. Only linear and quadratic
+ * tetrahedrons are kept.
+ */
+bool
+NetgenVolMesh::read_volume_elements(TextScanner& scanner, bool verbose)
+{
+    size_t n_items, matnr, np, p[4];
+    
+    if (verbose)
+    {
+        std::cout << "Loading tetrahedrons...";
+        std::cout.flush();
+    }
+    
+    if ( !scanner.read_size(n_items) )
+        return false;
+    
+    _tetList.reserve(_tetList.size() + n_items);
+    
+    while (n_items--)
+    {
+        if ( (n_items % PROGRESS_RECORDS) == 0 &&
+             !report_progress(scanner.offset()) )
+            return false;
+        
+        if ( !scanner.read_size(matnr) || !scanner.read_size(np) )
+            return false;
+        
+        if (np != 4 && np != 10)
+        {
+            _skipped++;
+            scanner.skip_line();
+            continue;
+        }
+        
+        for (size_t i = 0; i < 4; i++)
+            if ( !scanner.read_size(p[i]) || !point_in_range(p[i], MAX_POINTS) )
+                return false;
+        
+        _tetList.add(matnr, Tetrahedron(p[0]-1, p[1]-1, p[2]-1, p[3]-1));
+        
+        scanner.skip_line();
+    }
+    
+    if (verbose)
+        std::cout << "done" << std::endl;
+    
+    return true;
+}
+
+/* A .vol file is a sequence of sections introduced by a keyword on its
+ * own line. The ones not needed here (edge segments, identifications,
+ * names...) have no letters at the start of their data lines, so they
+ * are skipped line by line until the next keyword.
+ */
+bool
+NetgenVolMesh::parse_text(TextScanner& scanner, bool verbose)
+{
+    bool        has_points = false;
+    bool        ok = true;
+    
+    _skipped = 0;
+    _tetList = ZoneList<Tetrahedron>();
+    _triList = ZoneList<Triangle>();
+    
+    char c;
+    while ( ok && (c = scanner.peek()) )
+    {
+        const char *word;
+        size_t      len;
+        
+        if ( !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) )
+        {
+            scanner.skip_line();
+            continue;
+        }
+        
+        scanner.read_word(word, len);
+        
+        if ( keyword_is(word, len, "surfaceelements") ||
+             keyword_is(word, len, "surfaceelementsgi") ||
+             keyword_is(word, len, "surfaceelementsuv") )
+            ok = read_surface_elements(scanner, verbose);
+        else if ( keyword_is(word, len, "volumeelements") )
+            ok = read_volume_elements(scanner, verbose);
+        else if ( keyword_is(word, len, "points") )
+            ok = has_points = read_points(scanner, verbose);
+        else if ( keyword_is(word, len, "endmesh") )
+            break;
+        else
+            scanner.skip_line();
+    }
+    
+    if (ok && has_points)
+        ok = _domains.assign(_tetList) && _boundaries.assign(_triList) &&
+             check_elements(true);
+    
+    _tetList = ZoneList<Tetrahedron>();
+    _triList = ZoneList<Triangle>();
+    
+    if (!ok || !has_points)
+    {
+        if (!_cancelled)
+            std::cout << "Parse error in .vol file at byte "
+                      << scanner.offset() << std::endl;
+        return false;
+    }
+    
+    if (_skipped)
+        std::cout << "Skipped " << _skipped
+                  << " elements that are not triangles or tetrahedrons"
+                  << std::endl;
+    
+    normalize_points();
+    
+    if (_monitor)
+    {
+        _monitor->pointsLoaded(_points);
+        for (auto& b : _boundaries)
+            _monitor->trianglesLoaded(b.data(), b.size());
+    }
+    
+    return true;
+}
+
+bool
+NetgenVolMesh::parse(const char *begin, const char *end, bool verbose)
+{
+    TextScanner scanner(begin, end);
+    return parse_text(scanner, verbose);
+}
+
+bool
+NetgenVolMesh::parse_stream(ByteStream& stream, bool verbose)
+{
+    TextScanner scanner(stream);
+    return parse_text(scanner, verbose);
+}
@@ -0,0 +1,138 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+/*******************************************************************/
+/* Number of worker threads used by the parallel algorithms */
+inline size_t
+worker_count(void)
+{
+    size_t n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+/* Run func(i) for every i in [0, count) on a pool of worker threads.
+ * Items are handed out dynamically, so uneven items balance themselves;
+ * the calling thread takes part in the work. Returns when all the items
+ * are done.
+ */
+template<typename F>
+void
+parallel_for(size_t count, const F& func)
+{
+    size_t nthreads = std::min(worker_count(), count);
+    
+    if (nthreads <= 1)
+    {
+        for (size_t i = 0; i < count; i++)
+            func(i);
+        return;
+    }
+    
+    std::atomic<size_t> next(0);
+    
+    auto worker = [&]() {
+        size_t i;
+        while ( (i = next++) < count )
+            func(i);
+    };
+    
+    std::vector<std::thread> pool;
+    pool.reserve(nthreads-1);
+    for (size_t t = 0; t < nthreads-1; t++)
+        pool.push_back( std::thread(worker) );
+    
+    worker();
+    
+    for (auto& th : pool)
+        th.join();
+}
+
+/* Sorts v with less, sorting pieces of it in parallel and merging them
+ * pairwise, also in parallel. For a strict total order the result is
+ * the same as std::sort's. */
+template<typename T, typename Less>
+void
+parallel_sort(std::vector<T>& v, const Less& less)
+{
+    const size_t min_piece = 65536;
+    size_t n = v.size();
+    size_t npieces = 1;
+    
+    while (npieces < worker_count() && n/(2*npieces) >= min_piece)
+        npieces *= 2;
+    
+    if (npieces == 1)
+    {
+        std::sort(v.begin(), v.end(), less);
+        return;
+    }
+    
+    size_t piece = (n + npieces - 1)/npieces;
+    
+    parallel_for(npieces, [&](size_t p) {
+        size_t lo = std::min(n, p*piece);
+        size_t hi = std::min(n, lo + piece);
+        std::sort(v.begin() + lo, v.begin() + hi, less);
+    });
+    
+    std::vector<T> tmp(n);
+    T *src = v.data();
+    T *dst = tmp.data();
+    
+    for (size_t width = piece; width < n; width *= 2)
+    {
+        parallel_for((n + 2*width - 1)/(2*width), [&](size_t p) {
+            size_t lo = p*2*width;
+            size_t mid = std::min(n, lo + width);
+            size_t hi = std::min(n, lo + 2*width);
+            std::merge(src + lo, src + mid, src + mid, src + hi, dst + lo, less);
+        });
+        
+        std::swap(src, dst);
+    }
+    
+    if (src != v.data())
+        v.swap(tmp);
+}
+
+template<typename T>
+void
+parallel_sort(std::vector<T>& v)
+{
+    parallel_sort(v, std::less<T>());
+}
@@ -0,0 +1,179 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "Mesh.h"
+#include "PointStore.h"
+#include "Parallel.h"
+
+/* Points handled by a worker thread at a time */
+#define CHUNK_POINTS    65536
+
+/*****************************************************************************/
+void
+PointStore::clear(void)
+{
+    _x.clear();
+    _y.clear();
+    _z.clear();
+    _render.clear();
+}
+
+void
+PointStore::reserve(size_t n)
+{
+    _x.reserve(n);
+    _y.reserve(n);
+    _z.reserve(n);
+}
+
+void
+PointStore::resize(size_t n)
+{
+    _x.resize(n);
+    _y.resize(n);
+    _z.resize(n);
+}
+
+Point
+PointStore::operator[](size_t i) const
+{
+    return Point(_x[i], _y[i], _z[i]);
+}
+
+Point
+PointStore::at(size_t i) const
+{
+    return Point(_x.at(i), _y.at(i), _z.at(i));
+}
+
+/*****************************************************************************/
+/* Plain loops over a single array, so that the compiler turns them into
+ * packed min/max and multiply-add instructions.
+ */
+static void
+minmax(const double *v, size_t n, double& lo, double& hi)
+{
+    double l = v[0], h = v[0];
+    
+    for (size_t i = 1; i < n; i++)
+    {
+        l = (v[i] < l) ? v[i] : l;
+        h = (v[i] > h) ? v[i] : h;
+    }
+    
+    lo = l;
+    hi = h;
+}
+
+static void
+affine(double *v, size_t n, double center, double scale)
+{
+    for (size_t i = 0; i < n; i++)
+        v[i] = (v[i] - center)/scale;
+}
+
+static void
+pack(const double *x, const double *y, const double *z, size_t n, GLfloat *out)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        out[3*i+0] = x[i];
+        out[3*i+1] = y[i];
+        out[3*i+2] = z[i];
+    }
+}
+
+/*****************************************************************************/
+void
+PointStore::bounds(size_t begin, size_t end, double min[3], double max[3]) const
+{
+    if (begin >= end)
+        return;
+    
+    size_t n = end - begin;
+    size_t chunks = (n + CHUNK_POINTS - 1)/CHUNK_POINTS;
+    std::vector<double> lo(3*chunks), hi(3*chunks);
+    
+    parallel_for(chunks, [&](size_t c) {
+        size_t first = begin + c*CHUNK_POINTS;
+        size_t count = std::min(end - first, size_t(CHUNK_POINTS));
+        
+        minmax(_x.data() + first, count, lo[3*c+0], hi[3*c+0]);
+        minmax(_y.data() + first, count, lo[3*c+1], hi[3*c+1]);
+        minmax(_z.data() + first, count, lo[3*c+2], hi[3*c+2]);
+    });
+    
+    for (size_t d = 0; d < 3; d++)
+    {
+        min[d] = lo[d];
+        max[d] = hi[d];
+        
+        for (size_t c = 1; c < chunks; c++)
+        {
+            if ( lo[3*c+d] < min[d] ) min[d] = lo[3*c+d];
+            if ( hi[3*c+d] > max[d] ) max[d] = hi[3*c+d];
+        }
+    }
+}
+
+void
+PointStore::normalize(const double center[3], double scale)
+{
+    size_t chunks = (size() + CHUNK_POINTS - 1)/CHUNK_POINTS;
+    
+    _render.resize(3*size());
+    
+    parallel_for(chunks, [&](size_t c) {
+        size_t first = c*CHUNK_POINTS;
+        size_t count = std::min(size() - first, size_t(CHUNK_POINTS));
+        
+        affine(_x.data() + first, count, center[0], scale);
+        affine(_y.data() + first, count, center[1], scale);
+        affine(_z.data() + first, count, center[2], scale);
+        pack(_x.data() + first, _y.data() + first, _z.data() + first,
+             count, _render.data() + 3*first);
+    });
+}
+
+void
+PointStore::updateRenderBuffer(void)
+{
+    size_t chunks = (size() + CHUNK_POINTS - 1)/CHUNK_POINTS;
+    
+    _render.resize(3*size());
+    
+    parallel_for(chunks, [&](size_t c) {
+        size_t first = c*CHUNK_POINTS;
+        size_t count = std::min(size() - first, size_t(CHUNK_POINTS));
+        
+        pack(_x.data() + first, _y.data() + first, _z.data() + first,
+             count, _render.data() + 3*first);
+    });
+}
@@ -0,0 +1,107 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cmath>
+
+#include <QGLWidget>
+
+class Point;
+
+/*******************************************************************/
+/* The mesh points, stored as three contiguous arrays of coordinates,
+ * plus a packed x,y,z float copy of them ready to be handed to OpenGL.
+ * The float copy is rebuilt by normalize() and updateRenderBuffer().
+ */
+class PointStore
+{
+    std::vector<double>     _x, _y, _z;
+    std::vector<GLfloat>    _render;
+    
+public:
+    size_t  size(void) const { return _x.size(); }
+    bool    empty(void) const { return _x.empty(); }
+    
+    void    clear(void);
+    void    reserve(size_t);
+    void    resize(size_t);
+    
+    void
+    push_back(double x, double y, double z)
+    {
+        _x.push_back(x);
+        _y.push_back(y);
+        _z.push_back(z);
+    }
+    
+    void
+    set(size_t i, double x, double y, double z)
+    {
+        _x[i] = x;
+        _y[i] = y;
+        _z[i] = z;
+    }
+    
+    Point   operator[](size_t) const;
+    Point   at(size_t) const;
+    
+    double
+    distance(size_t a, size_t b) const
+    {
+        double dx, dy, dz;
+        
+        dx = _x[a] - _x[b];
+        dy = _y[a] - _y[b];
+        dz = _z[a] - _z[b];
+        
+        return sqrt(dx*dx + dy*dy + dz*dz);
+    }
+    
+    const double *  x(void) const { return _x.data(); }
+    const double *  y(void) const { return _y.data(); }
+    const double *  z(void) const { return _z.data(); }
+    double *        x(void) { return _x.data(); }
+    double *        y(void) { return _y.data(); }
+    double *        z(void) { return _z.data(); }
+    
+    /* Packed x,y,z floats, 3*size() of them */
+    const GLfloat * render(void) const { return _render.data(); }
+    
+    /* Bounding box of the points in [begin, end) */
+    void    bounds(size_t begin, size_t end, double min[3], double max[3]) const;
+    
+    /* Maps every point p to (p - center)/scale */
+    void    normalize(const double center[3], double scale);
+    
+    void    updateRenderBuffer(void);
+};
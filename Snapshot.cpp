@@ -0,0 +1,434 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <future>
+#include <algorithm>
+#include <cstdio>
+
+#include <QImage>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+
+#ifdef HAVE_OSMESA
+#include <GL/osmesa.h>
+#endif
+
+#include "Snapshot.h"
+#include "MeshLoader.h"
+#include "View.h"
+
+#define SNAPSHOT_WIDTH  800
+#define SNAPSHOT_HEIGHT 600
+
+static const CameraPreset presets[] = {
+    { "front",     0,    0, 1 },
+    { "back",      0,  180, 1 },
+    { "left",      0,   90, 1 },
+    { "right",     0,  -90, 1 },
+    { "top",      90,    0, 1 },
+    { "bottom",  -90,    0, 1 },
+    { "iso",      30,   45, 1 },
+};
+
+const CameraPreset *
+find_preset(const char *name)
+{
+    for (auto& p : presets)
+        if ( !strcmp(p.name, name) )
+            return &p;
+    
+    return nullptr;
+}
+
+bool
+save_png(const QString& path, const uint32_t *pixels, int width, int height)
+{
+    QImage image((const uchar *)pixels, width, height, QImage::Format_RGB32);
+    return image.save(path, "PNG");
+}
+
+/*****************************************************************************/
+SnapshotRenderer::SnapshotRenderer()
+    : _framebuffer(0), _color(0), _depth(0), _width(0), _height(0),
+      _kind(MeshRenderer::KIND_BOUNDARIES), _wireframe(true)
+{}
+
+bool
+SnapshotRenderer::initialize(const GLFunctions::Resolver& resolver,
+                             int width, int height)
+{
+    if ( !_renderer.initialize(resolver) )
+        return false;
+    
+    const GLFunctions& gl = _renderer.functions();
+    
+    _width = width;
+    _height = height;
+    
+    gl.GenRenderbuffers(1, &_color);
+    gl.BindRenderbuffer(GL_RENDERBUFFER, _color);
+    gl.RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    
+    gl.GenRenderbuffers(1, &_depth);
+    gl.BindRenderbuffer(GL_RENDERBUFFER, _depth);
+    gl.RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+                           width, height);
+    gl.BindRenderbuffer(GL_RENDERBUFFER, 0);
+    
+    gl.GenFramebuffers(1, &_framebuffer);
+    gl.BindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    gl.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_RENDERBUFFER, _color);
+    gl.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                               GL_RENDERBUFFER, _depth);
+    
+    if (gl.CheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "Cannot render to a " << width << "x" << height
+                  << " framebuffer" << std::endl;
+        release();
+        return false;
+    }
+    
+    /* As MeshGLWidget::initializeGL() */
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LEQUAL);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+    
+    return true;
+}
+
+void
+SnapshotRenderer::setMesh(NetgenNeutralMesh& nnm, MeshRenderer::ZoneKind kind,
+                          bool wireframe)
+{
+    _renderer.setMesh(nnm);
+    _kind = kind;
+    _wireframe = wireframe;
+    _draws.clear();
+    
+    size_t count = (kind == MeshRenderer::KIND_BOUNDARIES) ?
+                   nnm.boundaries().size() : nnm.domains().size();
+    
+    if (kind == MeshRenderer::KIND_SHELLS)
+    {
+        std::vector<size_t> all;
+        for (size_t slot = 0; slot < count; slot++)
+            all.push_back(slot);
+        
+        nnm.topology().buildShells(all);
+    }
+    
+    for (size_t slot = 0; slot < count; slot++)
+    {
+        MeshRenderer::ZoneGeometry g;
+        g.kind = kind;
+        g.slot = slot;
+        g.edges = wireframe;
+        g.level = 0;
+        
+        MeshRenderer::buildZone(nnm, g);
+        _renderer.uploadZone(g);
+        
+        /* The colors of the interactive view */
+        if (kind == MeshRenderer::KIND_BOUNDARIES)
+        {
+            _draws.push_back({ slot, 0, { 0.3f, 0.3f, 0.3f, 0.0f } });
+            continue;
+        }
+        
+        Domain& d = nnm.domains().zone(slot);
+        GLfloat alpha = (kind == MeshRenderer::KIND_DOMAINS) ? d.alpha() : 0.0f;
+        _draws.push_back({ slot, 0, { d.red(), d.green(), d.blue(), alpha } });
+    }
+}
+
+void
+SnapshotRenderer::render(const CameraPreset& camera,
+                         std::vector<uint32_t>& pixels)
+{
+    const GLFunctions& gl = _renderer.functions();
+    double aspect = _width/(double)_height;
+    
+    gl.BindFramebuffer(GL_FRAMEBUFFER, _framebuffer);
+    glViewport(0, 0, _width, _height);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(-VIEW_SCALE*aspect, VIEW_SCALE*aspect, -VIEW_SCALE, VIEW_SCALE,
+            -VIEW_ZOOM_MAX*VIEW_SCALE, VIEW_ZOOM_MAX*VIEW_SCALE);
+    
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    glRotatef(camera.rotX, 1.0f, 0.0f, 0.0f);
+    glRotatef(camera.rotY, 0.0f, 1.0f, 0.0f);
+    glScalef(camera.zoom, camera.zoom, camera.zoom);
+    
+    _renderer.begin();
+    _renderer.drawZones(_kind, _wireframe, _draws);
+    _renderer.end();
+    
+    pixels.resize(size_t(_width)*_height);
+    glReadPixels(0, 0, _width, _height, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV,
+                 pixels.data());
+    
+    /* GL puts the bottom row first */
+    for (int y = 0; y < _height/2; y++)
+        std::swap_ranges(&pixels[size_t(y)*_width],
+                         &pixels[size_t(y+1)*_width],
+                         &pixels[size_t(_height-1-y)*_width]);
+    
+    gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void
+SnapshotRenderer::release(void)
+{
+    if ( !_renderer.ready() )
+        return;
+    
+    const GLFunctions& gl = _renderer.functions();
+    
+    if (_framebuffer)
+        gl.DeleteFramebuffers(1, &_framebuffer);
+    if (_color)
+        gl.DeleteRenderbuffers(1, &_color);
+    if (_depth)
+        gl.DeleteRenderbuffers(1, &_depth);
+    
+    _framebuffer = _color = _depth = 0;
+    _renderer.release();
+}
+
+/*****************************************************************************/
+static void
+usage(void)
+{
+    std::cout << "Usage: meshview --snapshot [-o directory] [-s WIDTHxHEIGHT]"
+              << std::endl
+              << "           [-p preset,...] [-d triangles|tetrahedrons|shells]"
+              << " [-f] mesh..." << std::endl
+              << "-f draws filled faces instead of wireframes" << std::endl
+              << "Presets:";
+    
+    for (auto& p : presets)
+        std::cout << " " << p.name;
+    
+    std::cout << std::endl;
+}
+
+#ifdef HAVE_OSMESA
+static std::shared_ptr<NetgenNeutralMesh>
+load_mesh(QString path)
+{
+    std::shared_ptr<NetgenNeutralMesh> nnm = MeshLoader::makeMesh(path);
+    
+    if ( !nnm->load(path.toStdString()) )
+        return nullptr;
+    
+    return nnm;
+}
+#endif
+
+/* Every mesh is loaded while the previous one is rendered */
+int
+run_snapshots(int argc, char **argv)
+{
+    QString outdir = ".";
+    int width = SNAPSHOT_WIDTH, height = SNAPSHOT_HEIGHT;
+    std::vector<const CameraPreset *> cameras;
+    MeshRenderer::ZoneKind kind = MeshRenderer::KIND_BOUNDARIES;
+    bool wireframe = true;
+    QStringList meshes;
+    
+    for (int i = 1; i < argc; i++)
+    {
+        QString arg = argv[i];
+        bool has_value = (i+1 < argc);
+        
+        if (arg == "--snapshot")
+            continue;
+        
+        if (arg == "-o" && has_value)
+            outdir = argv[++i];
+        else if (arg == "-s" && has_value)
+        {
+            if ( sscanf(argv[++i], "%dx%d", &width, &height) != 2 ||
+                 width <= 0 || height <= 0 )
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (arg == "-p" && has_value)
+        {
+            for (auto& name : QString(argv[++i]).split(","))
+            {
+                const CameraPreset *p = find_preset(name.toStdString().c_str());
+                if (!p)
+                {
+                    std::cout << "Unknown camera preset " << name.toStdString()
+                              << std::endl;
+                    usage();
+                    return 1;
+                }
+                cameras.push_back(p);
+            }
+        }
+        else if (arg == "-d" && has_value)
+        {
+            QString what = argv[++i];
+            if (what == "triangles")
+                kind = MeshRenderer::KIND_BOUNDARIES;
+            else if (what == "tetrahedrons")
+                kind = MeshRenderer::KIND_DOMAINS;
+            else if (what == "shells")
+                kind = MeshRenderer::KIND_SHELLS;
+            else
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (arg == "-f")
+            wireframe = false;
+        else if ( arg.startsWith("-") )
+        {
+            usage();
+            return 1;
+        }
+        else
+            meshes << arg;
+    }
+    
+    if ( meshes.isEmpty() )
+    {
+        usage();
+        return 1;
+    }
+    
+    if ( cameras.empty() )
+        cameras.push_back( find_preset("iso") );
+    
+#ifndef HAVE_OSMESA
+    (void) kind;
+    (void) wireframe;
+    std::cout << "Snapshots need meshview built with qmake CONFIG+=osmesa"
+              << std::endl;
+    return 1;
+#else
+    /* Frames go to the framebuffer object, the context only needs a
+     * buffer to be made current */
+    const int attribs[] = {
+        OSMESA_FORMAT,                  OSMESA_RGBA,
+        OSMESA_DEPTH_BITS,              24,
+        OSMESA_PROFILE,                 OSMESA_COMPAT_PROFILE,
+        OSMESA_CONTEXT_MAJOR_VERSION,   3,
+        OSMESA_CONTEXT_MINOR_VERSION,   1,
+        0
+    };
+    
+    OSMesaContext ctx = OSMesaCreateContextAttribs(attribs, nullptr);
+    uint32_t buffer = 0;
+    
+    if ( !ctx || !OSMesaMakeCurrent(ctx, &buffer, GL_UNSIGNED_BYTE, 1, 1) )
+    {
+        std::cout << "Cannot create an OSMesa OpenGL 3.1 context" << std::endl;
+        if (ctx)
+            OSMesaDestroyContext(ctx);
+        return 1;
+    }
+    
+    SnapshotRenderer renderer;
+    if ( !renderer.initialize([](const char *name) {
+             return (void *) OSMesaGetProcAddress(name);
+         }, width, height) )
+    {
+        OSMesaDestroyContext(ctx);
+        return 1;
+    }
+    
+    QDir().mkpath(outdir);
+    
+    std::vector<uint32_t> pixels;
+    int failures = 0;
+    
+    auto next = std::async(std::launch::async, load_mesh, meshes[0]);
+    
+    for (int m = 0; m < meshes.size(); m++)
+    {
+        std::shared_ptr<NetgenNeutralMesh> nnm = next.get();
+        
+        if (m+1 < meshes.size())
+            next = std::async(std::launch::async, load_mesh, meshes[m+1]);
+        
+        if (!nnm)
+        {
+            std::cout << "Problem loading mesh " << meshes[m].toStdString()
+                      << std::endl;
+            failures++;
+            continue;
+        }
+        
+        renderer.setMesh(*nnm, kind, wireframe);
+        
+        QString base = QFileInfo(meshes[m]).completeBaseName();
+        
+        for (auto camera : cameras)
+        {
+            QString path = QDir(outdir).filePath(base + "_" + camera->name +
+                                                 ".png");
+            
+            renderer.render(*camera, pixels);
+            
+            if ( !save_png(path, pixels.data(), width, height) )
+            {
+                std::cout << "Cannot write " << path.toStdString() << std::endl;
+                failures++;
+                continue;
+            }
+            
+            std::cout << path.toStdString() << std::endl;
+        }
+    }
+    
+    renderer.release();
+    OSMesaDestroyContext(ctx);
+    
+    return failures ? 1 : 0;
+#endif
+}
@@ -0,0 +1,88 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include <QString>
+
+#include "MeshRenderer.h"
+
+/* A view of the mesh as the interactive one sets it up: rotations about
+ * x then y, in degrees, then zoom */
+struct CameraPreset
+{
+    const char  *name;
+    GLfloat     rotX, rotY;
+    GLfloat     zoom;
+};
+
+/*******************************************************************/
+/* Renders meshes into a framebuffer object of a fixed size, in the GL
+ * context that is current when initialize() is called, the same way
+ * the interactive view draws them, in wireframe or filled. Frames are read back
+ * as 32 bit pixels, top row first, laid out as QImage::Format_RGB32.
+ */
+class SnapshotRenderer
+{
+    MeshRenderer                        _renderer;
+    GLuint                              _framebuffer, _color, _depth;
+    int                                 _width, _height;
+    
+    MeshRenderer::ZoneKind              _kind;
+    bool                                _wireframe;
+    std::vector<MeshRenderer::ZoneDraw> _draws;
+    
+public:
+    SnapshotRenderer();
+    
+    bool    initialize(const GLFunctions::Resolver&, int, int);
+    
+    /* Builds and uploads all the zones of a kind, as edges for a
+     * wireframe or as faces */
+    void    setMesh(NetgenNeutralMesh&, MeshRenderer::ZoneKind, bool);
+    void    render(const CameraPreset&, std::vector<uint32_t>&);
+    
+    int     width(void) const { return _width; }
+    int     height(void) const { return _height; }
+    
+    void    release(void);
+};
+
+/* Camera presets by name, nullptr if there is none */
+const CameraPreset *    find_preset(const char *);
+
+/* Writes the pixels of a frame; false on failure */
+bool    save_png(const QString&, const uint32_t *, int, int);
+
+/* meshview --snapshot [options] mesh...; returns the exit status */
+int     run_snapshots(int, char **);
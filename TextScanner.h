@@ -0,0 +1,336 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <clocale>
+#include <string>
+
+#ifdef __APPLE__
+#include <xlocale.h>
+#endif
+
+/*******************************************************************/
+/* Source of input that is produced a piece at a time, such as a
+ * decompressor. */
+class ByteStream
+{
+public:
+    virtual ~ByteStream() {}
+    
+    /* Make more input available. The unread bytes [cur, end) are kept
+     * in front of the new ones; on return cur and end delimit the new
+     * window. Returns false, leaving cur and end alone, when there is
+     * no more input. */
+    virtual bool    refill(const char *& cur, const char *& end) = 0;
+    
+    /* True if the input ended because of an error */
+    virtual bool    failed(void) const { return false; }
+};
+
+/*******************************************************************/
+/* Whitespace separated number scanner working directly on a memory
+ * range (usually a MappedFile). Unlike operator>> it does not consult
+ * the locale and does not need the input to be NUL terminated. It does
+ * not allocate either, except for numbers of more than TOKEN_MAX
+ * characters that need strtod().
+ *
+ * The scanner can also read from a ByteStream, through the stream's
+ * window. Before each token it makes sure LOOKAHEAD bytes are buffered,
+ * so the number parsers never have to deal with a token cut in two.
+ * position() and seek() only make sense on memory ranges.
+ */
+class TextScanner
+{
+    static const size_t LOOKAHEAD = 1024;
+    static const size_t TOKEN_MAX = 64;
+    
+    const char      *_begin, *_cur, *_end;
+    ByteStream      *_stream;
+    size_t          _consumed;      /* bytes before _begin */
+    
+    static bool
+    is_space(char c)
+    {
+        return c == ' ' || c == '\n' || c == '\t' || c == '\r' ||
+               c == '\v' || c == '\f';
+    }
+    
+    static bool
+    is_digit(char c)
+    {
+        return (unsigned char)(c - '0') < 10;
+    }
+    
+    bool
+    fill(void)
+    {
+        const char *cur = _cur, *end = _end;
+        
+        if ( !_stream || !_stream->refill(cur, end) )
+            return false;
+        
+        _consumed += _cur - _begin;
+        _begin = _cur = cur;
+        _end = end;
+        return true;
+    }
+    
+    void
+    skip_ws(void)
+    {
+        for (;;)
+        {
+            while (_cur < _end && is_space(*_cur))
+                _cur++;
+            
+            if ( !_stream || size_t(_end - _cur) >= LOOKAHEAD || !fill() )
+                return;
+        }
+    }
+    
+    /* For strtod_l(): the decimal point must not depend on the locale
+     * of the program */
+    static locale_t
+    c_locale(void)
+    {
+        static locale_t loc = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+        return loc;
+    }
+    
+    /* 10^e for the exponents where the conversion below is exact */
+    static double
+    exact_pow10(int e)
+    {
+        static const double tab[] = {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+            1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+            1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+        return tab[e];
+    }
+    
+public:
+    TextScanner(const char *begin, const char *end)
+        : _begin(begin), _cur(begin), _end(end),
+          _stream(nullptr), _consumed(0)
+    {}
+    
+    TextScanner(ByteStream& stream)
+        : _begin(nullptr), _cur(nullptr), _end(nullptr),
+          _stream(&stream), _consumed(0)
+    {}
+    
+    bool        eof(void) { skip_ws(); return _cur == _end; }
+    
+    const char *position(void) const { return _cur; }
+    size_t      offset(void) const { return _consumed + (_cur - _begin); }
+    void        seek(const char *pos) { _cur = pos; }
+    
+    /* Next non-blank character, 0 at the end of input */
+    char
+    peek(void)
+    {
+        skip_ws();
+        return (_cur < _end) ? *_cur : 0;
+    }
+    
+    void
+    skip_line(void)
+    {
+        for (;;)
+        {
+            const char *nl = nullptr;
+            
+            if (_cur < _end)
+                nl = (const char *)memchr(_cur, '\n', _end - _cur);
+            
+            if (nl)
+            {
+                _cur = nl;
+                return;
+            }
+            
+            _cur = _end;
+            if ( !fill() )
+                return;
+        }
+    }
+    
+    /* A run of non-blank characters. The word points into the input and
+     * is not NUL terminated. */
+    bool
+    read_word(const char *& word, size_t& len)
+    {
+        skip_ws();
+        
+        word = _cur;
+        while (_cur < _end && !is_space(*_cur))
+            _cur++;
+        
+        len = _cur - word;
+        return len != 0;
+    }
+    
+    bool
+    read_size(size_t& val)
+    {
+        skip_ws();
+        
+        if (_cur < _end && *_cur == '+')
+            _cur++;
+        
+        if (_cur == _end || !is_digit(*_cur))
+            return false;
+        
+        size_t v = 0;
+        while (_cur < _end && is_digit(*_cur))
+        {
+            size_t d = *_cur++ - '0';
+            if ( v > (SIZE_MAX - d)/10 )
+                return false;
+            v = v*10 + d;
+        }
+        
+        val = v;
+        return true;
+    }
+    
+    /* Decimal floating point of the form [+-]ddd[.ddd][(e|E)[+-]ddd].
+     * Up to 19 significant digits are accumulated in an integer; when the
+     * mantissa fits in 53 bits and the decimal exponent is within
+     * [-22, 22] (the case for everything netgen writes) the result is
+     * correctly rounded directly. Otherwise the token is handed to
+     * strtod(), in the C locale, so the result is always the same as
+     * strtod() gives.
+     */
+    bool
+    read_double(double& val)
+    {
+        skip_ws();
+        
+        const char *start = _cur;
+        bool neg = false;
+        if (_cur < _end && (*_cur == '-' || *_cur == '+'))
+            neg = (*_cur++ == '-');
+        
+        uint64_t    mant = 0;
+        int         ndigits = 0, exp10 = 0;
+        bool        any = false;
+        
+        while (_cur < _end && is_digit(*_cur))
+        {
+            if (ndigits < 19)
+            {
+                mant = mant*10 + (*_cur - '0');
+                if (mant)
+                    ndigits++;
+            }
+            else
+                exp10++;
+            
+            any = true;
+            _cur++;
+        }
+        
+        if (_cur < _end && *_cur == '.')
+        {
+            _cur++;
+            while (_cur < _end && is_digit(*_cur))
+            {
+                if (ndigits < 19)
+                {
+                    mant = mant*10 + (*_cur - '0');
+                    if (mant)
+                        ndigits++;
+                    exp10--;
+                }
+                
+                any = true;
+                _cur++;
+            }
+        }
+        
+        if (!any)
+            return false;
+        
+        if (_cur < _end && (*_cur == 'e' || *_cur == 'E'))
+        {
+            const char *save = _cur++;
+            bool eneg = false;
+            
+            if (_cur < _end && (*_cur == '-' || *_cur == '+'))
+                eneg = (*_cur++ == '-');
+            
+            if (_cur == _end || !is_digit(*_cur))
+                _cur = save;    /* "1e" is the number 1 followed by junk */
+            else
+            {
+                int e = 0;
+                while (_cur < _end && is_digit(*_cur))
+                {
+                    if (e < 100000)
+                        e = e*10 + (*_cur - '0');
+                    _cur++;
+                }
+                exp10 += eneg ? -e : e;
+            }
+        }
+        
+        if ( mant < (uint64_t(1) << 53) && exp10 >= -22 && exp10 <= 22 )
+        {
+            double d = double(mant);
+            d = (exp10 < 0) ? d / exact_pow10(-exp10) : d * exact_pow10(exp10);
+            val = neg ? -d : d;
+            return true;
+        }
+        
+        /* The token is whole in the buffer, but not NUL terminated */
+        size_t len = _cur - start;
+        if (len <= TOKEN_MAX)
+        {
+            char token[TOKEN_MAX + 1];
+            memcpy(token, start, len);
+            token[len] = 0;
+            val = strtod_l(token, nullptr, c_locale());
+        }
+        else
+        {
+            std::string token(start, _cur);
+            val = strtod_l(token.c_str(), nullptr, c_locale());
+        }
+        return true;
+    }
+};
+
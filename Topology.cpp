@@ -0,0 +1,316 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <algorithm>
+
+#include "Topology.h"
+#include "Edges.h"
+#include "Parallel.h"
+
+const uint32_t FaceTets::NO_TET;
+
+/* Tetrahedrons, or faces, handled by a worker thread at a time */
+#define CHUNK_TETS      65536
+
+namespace {
+
+/* A face of a tetrahedron, ordered by its points then by the tet */
+struct FaceRecord
+{
+    uint64_t    p01;            /* p[0] << 32 | p[1] */
+    uint64_t    p2t;            /* p[2] << 32 | tet */
+    
+    bool
+    operator<(const FaceRecord& other) const
+    {
+        return (p01 < other.p01) || (p01 == other.p01 && p2t < other.p2t);
+    }
+    
+    bool
+    sameFace(const FaceRecord& other) const
+    {
+        return p01 == other.p01 && (p2t >> 32) == (other.p2t >> 32);
+    }
+};
+
+} // namespace
+
+/*****************************************************************************/
+MeshTopology::MeshTopology(ZoneTable<Tetrahedron>& domains)
+    : _domains(domains), _edgesValid(false), _facesValid(false),
+      _nonManifoldFaces(0)
+{}
+
+void
+MeshTopology::clear(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    _edges = nullptr;
+    _faces = nullptr;
+    _faceTets = nullptr;
+    _nonManifoldFaces = 0;
+    _shells.clear();
+    _edgesValid = _facesValid = false;
+}
+
+void
+MeshTopology::build_edges(void)
+{
+    _edges = std::make_shared<const std::vector<uint64_t>>(
+                unique_edges(_domains.elements(), _domains.elementCount()) );
+    _edgesValid = true;
+}
+
+/* Every tetrahedron contributes its four faces; sorting them brings
+ * the copies of a face next to each other, with the tets they come
+ * from. */
+void
+MeshTopology::build_faces(void)
+{
+    size_t ntets = _domains.elementCount();
+    const Tetrahedron *tets = _domains.elements();
+    
+    auto faces = std::make_shared<std::vector<MeshFace>>();
+    auto faceTets = std::make_shared<std::vector<FaceTets>>();
+    
+    _faces = faces;
+    _faceTets = faceTets;
+    _nonManifoldFaces = 0;
+    _facesValid = true;
+    
+    if ( ntets >= FaceTets::NO_TET )
+    {
+        std::cout << "Too many tetrahedrons to compute the faces" << std::endl;
+        return;
+    }
+    
+    std::vector<FaceRecord> recs(4*ntets);
+    
+    parallel_for((ntets + CHUNK_TETS - 1)/CHUNK_TETS, [&](size_t c) {
+        size_t end = std::min(ntets, (c+1)*CHUNK_TETS);
+        
+        for (size_t t = c*CHUNK_TETS; t < end; t++)
+        {
+            static const int local[4][3] = {
+                {0, 1, 2}, {0, 1, 3}, {0, 2, 3}, {1, 2, 3}
+            };
+            
+            for (size_t f = 0; f < 4; f++)
+            {
+                FaceRecord& r = recs[4*t+f];
+                r.p01 = edge_key(tets[t][local[f][0]], tets[t][local[f][1]]);
+                r.p2t = (uint64_t(tets[t][local[f][2]]) << 32) | t;
+            }
+        }
+    });
+    
+    parallel_sort(recs);
+    
+    size_t nfaces = 0;
+    for (size_t i = 0; i < recs.size(); i++)
+        if ( i == 0 || !recs[i].sameFace(recs[i-1]) )
+            nfaces++;
+    
+    faces->resize(nfaces);
+    faceTets->resize(nfaces);
+    
+    size_t f = 0;
+    for (size_t i = 0; i < recs.size(); f++)
+    {
+        size_t j = i+1;
+        while ( j < recs.size() && recs[j].sameFace(recs[i]) )
+            j++;
+        
+        (*faces)[f].p[0] = edge_first(recs[i].p01);
+        (*faces)[f].p[1] = edge_second(recs[i].p01);
+        (*faces)[f].p[2] = recs[i].p2t >> 32;
+        
+        (*faceTets)[f].tet[0] = uint32_t(recs[i].p2t);
+        (*faceTets)[f].tet[1] = (j-i > 1) ? uint32_t(recs[i+1].p2t) : FaceTets::NO_TET;
+        
+        if (j-i > 2)
+            _nonManifoldFaces++;
+        
+        i = j;
+    }
+}
+
+/* A face belongs to the shell of the domain of each of its sides,
+ * unless both sides are in the same domain. The faces are split in
+ * chunks whose results are appended in order, so every shell keeps the
+ * order of faces(). */
+void
+MeshTopology::build_shells(const std::vector<size_t>& slots)
+{
+    if (!_facesValid)
+        build_faces();
+    
+    if ( _shells.size() != _domains.size() )
+        _shells.assign(_domains.size(), nullptr);
+    
+    std::vector<size_t> todo;
+    for (auto s : slots)
+        if ( s < _shells.size() && !_shells[s] &&
+             std::find(todo.begin(), todo.end(), s) == todo.end() )
+            todo.push_back(s);
+    
+    if ( todo.empty() )
+        return;
+    
+    const size_t NO_SLOT = size_t(-1);
+    std::vector<size_t> wanted(_domains.size(), NO_SLOT);
+    for (size_t i = 0; i < todo.size(); i++)
+        wanted[todo[i]] = i;
+    
+    const std::vector<MeshFace>& faces = *_faces;
+    const std::vector<FaceTets>& faceTets = *_faceTets;
+    size_t nfaces = faces.size();
+    size_t chunks = (nfaces + CHUNK_TETS - 1)/CHUNK_TETS;
+    std::vector<std::vector<MeshFace>> parts(chunks*todo.size());
+    
+    parallel_for(chunks, [&](size_t c) {
+        size_t end = std::min(nfaces, (c+1)*CHUNK_TETS);
+        
+        for (size_t f = c*CHUNK_TETS; f < end; f++)
+        {
+            const FaceTets& ft = faceTets[f];
+            size_t d0 = _domains.slotOf(ft.tet[0]);
+            size_t d1 = (ft.tet[1] == FaceTets::NO_TET) ?
+                        NO_SLOT : _domains.slotOf(ft.tet[1]);
+            
+            if (d0 == d1)
+                continue;
+            
+            if ( wanted[d0] != NO_SLOT )
+                parts[c*todo.size() + wanted[d0]].push_back(faces[f]);
+            
+            if ( d1 != NO_SLOT && wanted[d1] != NO_SLOT )
+                parts[c*todo.size() + wanted[d1]].push_back(faces[f]);
+        }
+    });
+    
+    parallel_for(todo.size(), [&](size_t i) {
+        auto shell = std::make_shared<std::vector<MeshFace>>();
+        
+        for (size_t c = 0; c < chunks; c++)
+        {
+            auto& part = parts[c*todo.size() + i];
+            shell->insert(shell->end(), part.begin(), part.end());
+        }
+        
+        _shells[ todo[i] ] = shell;
+    });
+}
+
+/*****************************************************************************/
+EdgeTable
+MeshTopology::edges(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    if (!_edgesValid)
+        build_edges();
+    
+    return _edges;
+}
+
+FaceTable
+MeshTopology::faces(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    if (!_facesValid)
+        build_faces();
+    
+    return _faces;
+}
+
+FaceTetsTable
+MeshTopology::faceTets(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    if (!_facesValid)
+        build_faces();
+    
+    return _faceTets;
+}
+
+size_t
+MeshTopology::nonManifoldFaces(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    if (!_facesValid)
+        build_faces();
+    
+    return _nonManifoldFaces;
+}
+
+void
+MeshTopology::buildShells(const std::vector<size_t>& slots)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    build_shells(slots);
+}
+
+FaceTable
+MeshTopology::shell(size_t slot)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    build_shells( std::vector<size_t>(1, slot) );
+    
+    return _shells.at(slot);
+}
+
+size_t
+MeshTopology::memoryUsage(void)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    
+    size_t bytes = 0;
+    
+    if (_edges)
+        bytes += _edges->capacity()*sizeof(uint64_t);
+    
+    if (_faces)
+        bytes += _faces->capacity()*sizeof(MeshFace) +
+                 _faceTets->capacity()*sizeof(FaceTets);
+    
+    for (auto& s : _shells)
+        if (s)
+            bytes += s->capacity()*sizeof(MeshFace);
+    
+    return bytes;
+}
@@ -0,0 +1,117 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+#include "Mesh.h"
+
+/*******************************************************************/
+struct MeshFace
+{
+    typedef uint32_t    index_type;
+    
+    uint32_t    p[3];           /* sorted point indices */
+    
+    std::array<uint32_t, 3>
+    points(void) const { return {{ p[0], p[1], p[2] }}; }
+};
+
+/* The tetrahedrons on the two sides of a face, as indices into the
+ * connectivity array of the domains table. Faces on the outside of
+ * the mesh have NO_TET on one side. */
+struct FaceTets
+{
+    static const uint32_t NO_TET = uint32_t(-1);
+    
+    uint32_t    tet[2];
+};
+
+/*******************************************************************/
+/* Unique edges and faces of the tetrahedrons of a mesh, and the
+ * tetrahedrons around every face. Each table is built in parallel the
+ * first time it is asked for and kept until the mesh is loaded again;
+ * the accessors can be called from any thread. They hand out shared
+ * snapshots of the tables, which stay valid after a clear().
+ */
+typedef std::shared_ptr<const std::vector<uint64_t>>   EdgeTable;
+typedef std::shared_ptr<const std::vector<MeshFace>>   FaceTable;
+typedef std::shared_ptr<const std::vector<FaceTets>>   FaceTetsTable;
+
+class MeshTopology
+{
+    ZoneTable<Tetrahedron>      &_domains;
+    
+    std::mutex                  _mutex;
+    bool                        _edgesValid, _facesValid;
+    
+    EdgeTable                   _edges;
+    FaceTable                   _faces;
+    FaceTetsTable               _faceTets;
+    size_t                      _nonManifoldFaces;
+    
+    std::vector<FaceTable>      _shells;    /* null until built */
+    
+    void    build_edges(void);
+    void    build_faces(void);
+    void    build_shells(const std::vector<size_t>&);
+    
+public:
+    MeshTopology(ZoneTable<Tetrahedron>&);
+    
+    /* Sorted edge keys, see Edges.h */
+    EdgeTable       edges(void);
+    
+    /* Faces sorted by point indices, and the tetrahedrons on their
+     * sides, in the same order */
+    FaceTable       faces(void);
+    FaceTetsTable   faceTets(void);
+    
+    /* Faces shared by more than two tetrahedrons; only the first two
+     * are recorded in faceTets() */
+    size_t  nonManifoldFaces(void);
+    
+    /* The faces on the outside of a domain, given by slot: those that
+     * are not shared by two of its tetrahedrons. Shells are computed
+     * when first asked for, several of them in a single pass by
+     * buildShells(). */
+    void            buildShells(const std::vector<size_t>&);
+    FaceTable       shell(size_t);
+    
+    /* Bytes held by the tables built so far */
+    size_t  memoryUsage(void);
+    
+    void    clear(void);
+};
@@ -1,12 +1,23 @@
 #include <QtGui>
 
 #include <iostream>
+#include <cstring>
 
 #include "MainWindow.h"
 #include "Mesh.h"
+#include "Snapshot.h"
 
 int main(int argc, char **argv)
 {
+    for (int i = 1; i < argc; i++)
+    {
+        if ( !strcmp(argv[i], "--snapshot") )
+        {
+            QCoreApplication app(argc, argv);
+            return run_snapshots(argc, argv);
+        }
+    }
+    
     QApplication app(argc, argv);
     
     MainWindow mw;
@@ -16,4 +27,4 @@ int main(int argc, char **argv)
     //qcd.show();
     
     return app.exec();
-}
\ No newline at end of file
+}
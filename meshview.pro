@@ -10,7 +10,23 @@ mac {
     CONFIG -= app_bundle
 }
 
+CONFIG += thread
+
 QMAKE_CXXFLAGS += -std=c++11
+
+LIBS += -lz
+
+# zstd compressed meshes: qmake CONFIG+=zstd
+zstd {
+    DEFINES += HAVE_ZSTD
+    LIBS += -lzstd
+}
+
+# Headless snapshots (meshview --snapshot): qmake CONFIG+=osmesa
+osmesa {
+    DEFINES += HAVE_OSMESA
+    LIBS += -lOSMesa
+}
 QMAKE_MACOSX_DEPLOYMENT_TARGET = 10.8
 
 TEMPLATE = app
@@ -19,8 +35,17 @@ DEPENDPATH += .
 INCLUDEPATH += .
 
 # Input
-HEADERS += Mesh.h MeshGLWidget.h MainWindow.h ControllerWidget.h
+HEADERS += Mesh.h MeshGLWidget.h MainWindow.h ControllerWidget.h \
+           MappedFile.h TextScanner.h Parallel.h MeshCache.h \
+           MeshLoader.h NetgenVolMesh.h GmshMesh.h \
+           Decompressor.h PointStore.h Edges.h Topology.h \
+           GLFunctions.h MeshRenderer.h Lod.h Snapshot.h \
+           Export.h View.h FrameTimer.h
 SOURCES += main.cpp Mesh.cpp MeshGLWidget.cpp MainWindow.cpp \
-           ControllerWidget.cpp
+           ControllerWidget.cpp MappedFile.cpp MeshCache.cpp \
+           MeshLoader.cpp NetgenVolMesh.cpp \
+           GmshMesh.cpp Decompressor.cpp PointStore.cpp Edges.cpp \
+           Topology.cpp GLFunctions.cpp MeshRenderer.cpp Lod.cpp \
+           Snapshot.cpp Export.cpp FrameTimer.cpp
 
  INSTALLS += target
@@ -0,0 +1,128 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+#include <set>
+#include <random>
+#include <algorithm>
+
+#include "Mesh.h"
+#include "Edges.h"
+#include "Test.h"
+
+static std::vector<uint64_t>
+reference_unique(std::vector<uint64_t> keys)
+{
+    std::sort(keys.begin(), keys.end());
+    keys.erase( std::unique(keys.begin(), keys.end()), keys.end() );
+    return keys;
+}
+
+static bool
+sorts_as_reference(const std::vector<uint64_t>& keys)
+{
+    std::vector<uint64_t> sorted = keys;
+    sort_unique_keys(sorted);
+    return sorted == reference_unique(keys);
+}
+
+TEST(edges_sort_small)
+{
+    CHECK( sorts_as_reference({}) );
+    CHECK( sorts_as_reference({ 5 }) );
+    CHECK( sorts_as_reference({ 7, 7 }) );
+    CHECK( sorts_as_reference({ 3, 1, 2, 1, 3 }) );
+    CHECK( sorts_as_reference({ ~uint64_t(0), 0, uint64_t(1) << 63, 0 }) );
+}
+
+/* Enough keys for several blocks, with digits in every byte, with many
+ * duplicates, and with bytes that are the same for all the keys */
+TEST(edges_sort_large)
+{
+    std::mt19937_64 gen(1);
+    std::vector<uint64_t> full, dups, narrow;
+    
+    for (size_t i = 0; i < 1000000; i++)
+    {
+        uint64_t r = gen();
+        full.push_back(r);
+        dups.push_back(r % 1000);
+        narrow.push_back( edge_key(r % 50000, (r >> 32) % 50000 + 0x10000) );
+    }
+    
+    CHECK( sorts_as_reference(full) );
+    CHECK( sorts_as_reference(dups) );
+    CHECK( sorts_as_reference(narrow) );
+}
+
+TEST(edges_of_tetrahedrons)
+{
+    std::mt19937 gen(2);
+    std::vector<Tetrahedron> tets;
+    std::set<uint64_t> reference;
+    
+    for (size_t i = 0; i < 200000; i++)
+    {
+        uint32_t p[4];
+        
+        /* Neighbouring points, so that the tetrahedrons share edges */
+        p[0] = gen() % 20000;
+        for (size_t j = 1; j < 4; j++)
+            p[j] = p[0] + 1 + j*(gen() % 4);
+        
+        tets.push_back( Tetrahedron(p[0], p[1], p[2], p[3]) );
+        
+        std::sort(p, p+4);
+        for (size_t a = 0; a < 4; a++)
+            for (size_t b = a+1; b < 4; b++)
+                reference.insert( edge_key(p[a], p[b]) );
+    }
+    
+    std::vector<uint64_t> edges = unique_edges(tets.data(), tets.size());
+    CHECK( edges == std::vector<uint64_t>(reference.begin(), reference.end()) );
+}
+
+TEST(edges_lengths)
+{
+    PointStore points;
+    points.push_back(0, 0, 0);
+    points.push_back(3, 0, 0);
+    points.push_back(0, 4, 0);
+    
+    Triangle tri(0, 1, 2);
+    std::vector<uint64_t> edges = unique_edges(&tri, 1);
+    EdgeLengths lengths = edge_lengths(points, edges);
+    
+    CHECK( edges.size() == 3 );
+    CHECK( lengths.min == 3 && lengths.max == 5 && lengths.avg == 4 );
+    
+    lengths = edge_lengths(points, std::vector<uint64_t>());
+    CHECK( lengths.min == 0 && lengths.avg == 0 && lengths.max == 0 );
+}
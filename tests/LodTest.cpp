@@ -0,0 +1,182 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+
+#include "Mesh.h"
+#include "Lod.h"
+#include "Test.h"
+
+/* n x n points in the z = 0 plane, one apart, after a point that no
+ * triangle uses, and two triangles per square */
+static void
+make_grid(size_t n, PointStore& points, std::vector<Triangle>& tris)
+{
+    points.push_back(0, 0, 0);
+    
+    for (size_t j = 0; j < n; j++)
+        for (size_t i = 0; i < n; i++)
+            points.push_back(i, j, 0);
+    
+    for (size_t j = 0; j+1 < n; j++)
+    {
+        for (size_t i = 0; i+1 < n; i++)
+        {
+            size_t p = 1 + j*n + i;
+            tris.push_back( Triangle(p, p+1, p+n+1) );
+            tris.push_back( Triangle(p, p+n+1, p+n) );
+        }
+    }
+}
+
+static bool
+same_triangles(const std::vector<Triangle>& a, const std::vector<Triangle>& b)
+{
+    if ( a.size() != b.size() )
+        return false;
+    
+    for (size_t i = 0; i < a.size(); i++)
+        if ( a[i].points() != b[i].points() )
+            return false;
+    
+    return true;
+}
+
+/* The clustering done the slow way: every point of the triangles goes to
+ * the smallest point of its cell, the first of equal triangles is kept */
+static std::vector<Triangle>
+reference_proxy(const PointStore& points, const std::vector<Triangle>& tris,
+                size_t resolution)
+{
+    std::set<size_t> used;
+    for (auto& t : tris)
+        for (auto p : t.points())
+            used.insert(p);
+    
+    double min[3] = { 1e300, 1e300, 1e300 }, max[3] = { -1e300, -1e300, -1e300 };
+    for (auto p : used)
+    {
+        double c[3] = { points[p].x(), points[p].y(), points[p].z() };
+        for (size_t k = 0; k < 3; k++)
+        {
+            min[k] = std::min(min[k], c[k]);
+            max[k] = std::max(max[k], c[k]);
+        }
+    }
+    
+    double cell = std::max(max[0] - min[0], max[1] - min[1])/resolution;
+    
+    std::map<std::vector<size_t>, size_t> first;
+    std::map<size_t, size_t> rep;
+    for (auto p : used)
+    {
+        double c[3] = { points[p].x(), points[p].y(), points[p].z() };
+        std::vector<size_t> key;
+        for (size_t k = 0; k < 3; k++)
+            key.push_back( std::min(size_t((c[k] - min[k])/cell), resolution-1) );
+        
+        if ( !first.count(key) )
+            first[key] = p;
+        rep[p] = first[key];
+    }
+    
+    std::set<Triangle> seen;
+    std::vector<Triangle> proxy;
+    for (auto& t : tris)
+    {
+        auto p = t.points();
+        size_t r[3] = { rep[p[0]], rep[p[1]], rep[p[2]] };
+        if ( r[0] == r[1] || r[1] == r[2] || r[0] == r[2] )
+            continue;
+        
+        Triangle c(r[0], r[1], r[2]);
+        if ( seen.insert(c).second )
+            proxy.push_back(c);
+    }
+    
+    return proxy;
+}
+
+TEST(lod_nothing_to_cluster)
+{
+    PointStore points;
+    std::vector<Triangle> tris;
+    make_grid(4, points, tris);
+    
+    CHECK( cluster_triangles(points, tris.data(), 0, 16).empty() );
+    CHECK( cluster_triangles(points, tris.data(), tris.size(), 0).empty() );
+}
+
+/* Cells smaller than the triangles keep the surface as it is, in the
+ * same order */
+TEST(lod_fine_cells_keep_triangles)
+{
+    PointStore points;
+    std::vector<Triangle> tris;
+    make_grid(10, points, tris);
+    
+    std::vector<Triangle> proxy = cluster_triangles(points, tris.data(),
+                                                    tris.size(), 1024);
+    
+    CHECK( same_triangles(proxy, tris) );
+}
+
+TEST(lod_single_cell_collapses)
+{
+    PointStore points;
+    std::vector<Triangle> tris;
+    make_grid(10, points, tris);
+    
+    CHECK( cluster_triangles(points, tris.data(), tris.size(), 1).empty() );
+}
+
+/* Only points of the surface represent cells, point 0 lies in the first
+ * cell but is not used */
+TEST(lod_coarse_cells)
+{
+    PointStore points;
+    std::vector<Triangle> tris;
+    make_grid(300, points, tris);
+    
+    for (size_t resolution : { 2, 7, 50 })
+    {
+        std::vector<Triangle> proxy = cluster_triangles(points, tris.data(),
+                                                        tris.size(), resolution);
+        
+        CHECK( !proxy.empty() && proxy.size() < tris.size() );
+        CHECK( same_triangles(proxy, reference_proxy(points, tris, resolution)) );
+        
+        for (auto& t : proxy)
+            CHECK( t[0] != 0 );
+    }
+}
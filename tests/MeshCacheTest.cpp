@@ -0,0 +1,188 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+#include <fstream>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "Mesh.h"
+#include "MeshCache.h"
+#include "Test.h"
+
+static const char tet_mesh[] =
+    "4\n"
+    "  0.0 0.0 0.0\n"
+    "  1.0 0.0 0.0\n"
+    "  0.0 1.0 0.0\n"
+    "  0.0 0.0 1.0\n"
+    "1\n"
+    "1 1 2 3 4\n"
+    "4\n"
+    "1 1 3 2\n"
+    "2 1 2 4\n"
+    "3 1 4 3\n"
+    "4 2 3 4\n";
+
+/* Same size, other numbers */
+static const char moved_mesh[] =
+    "4\n"
+    "  0.0 0.0 0.0\n"
+    "  2.0 0.0 0.0\n"
+    "  0.0 1.0 0.0\n"
+    "  0.0 0.0 1.0\n"
+    "1\n"
+    "7 1 2 3 4\n"
+    "4\n"
+    "1 1 3 2\n"
+    "2 1 2 4\n"
+    "3 1 4 3\n"
+    "4 2 3 4\n";
+
+static bool
+set_mtime(const std::string& path, time_t sec)
+{
+    struct timespec ts[2];
+    ts[0].tv_sec = ts[1].tv_sec = sec;
+    ts[0].tv_nsec = ts[1].tv_nsec = 0;
+    return utimensat(AT_FDCWD, path.c_str(), ts, 0) == 0;
+}
+
+template<typename T>
+static bool
+same_zones(ZoneTable<T>& a, ZoneTable<T>& b)
+{
+    if ( a.size() != b.size() )
+        return false;
+    
+    for (size_t z = 0; z < a.size(); z++)
+    {
+        if ( a.zone(z).id() != b.zone(z).id() ||
+             a.zone(z).size() != b.zone(z).size() )
+            return false;
+        
+        for (size_t e = 0; e < a.zone(z).size(); e++)
+            if ( a.zone(z).data()[e].points() !=
+                 b.zone(z).data()[e].points() )
+                return false;
+    }
+    
+    return true;
+}
+
+static bool
+same_mesh(NetgenNeutralMesh& a, NetgenNeutralMesh& b)
+{
+    if ( a.points().size() != b.points().size() )
+        return false;
+    
+    for (size_t i = 0; i < a.points().size(); i++)
+        if ( a.points()[i].x() != b.points()[i].x() ||
+             a.points()[i].y() != b.points()[i].y() ||
+             a.points()[i].z() != b.points()[i].z() )
+            return false;
+    
+    return same_zones(a.domains(), b.domains()) &&
+           same_zones(a.boundaries(), b.boundaries()) &&
+           a.min_x() == b.min_x() && a.max_x() == b.max_x();
+}
+
+static bool
+file_exists(const std::string& path)
+{
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+/* The source is overwritten under the cache with other contents but the
+ * same size and time: what is loaded then can only come from the cache */
+TEST(cache_round_trip)
+{
+    std::string path = test_file("round_trip.mesh", tet_mesh);
+    CHECK( set_mtime(path, 1000000000) );
+    
+    NetgenNeutralMesh text;
+    text.setCacheEnabled(false);
+    CHECK( text.load(path) );
+    CHECK( !file_exists(mesh_cache_filename(path)) );
+    
+    NetgenNeutralMesh first;
+    CHECK( first.load(path) );
+    CHECK( file_exists(mesh_cache_filename(path)) );
+    CHECK( same_mesh(text, first) );
+    
+    test_file("round_trip.mesh", moved_mesh);
+    CHECK( set_mtime(path, 1000000000) );
+    
+    NetgenNeutralMesh cached;
+    CHECK( cached.load(path) );
+    CHECK( same_mesh(text, cached) );
+}
+
+TEST(cache_stale_after_change)
+{
+    std::string path = test_file("stale.mesh", tet_mesh);
+    CHECK( set_mtime(path, 1000000000) );
+    
+    NetgenNeutralMesh first;
+    CHECK( first.load(path) );
+    
+    test_file("stale.mesh", moved_mesh);
+    CHECK( set_mtime(path, 1000000001) );
+    
+    NetgenNeutralMesh moved, reloaded;
+    moved.setCacheEnabled(false);
+    CHECK( moved.load(path) );
+    CHECK( reloaded.load(path) );
+    CHECK( same_mesh(moved, reloaded) );
+    CHECK( !same_mesh(first, reloaded) );
+    CHECK( reloaded.domains().zone(0).id() == 7 );
+}
+
+/* A cache cut short is not trusted, the source is parsed again */
+TEST(cache_truncated)
+{
+    std::string path = test_file("truncated.mesh", tet_mesh);
+    CHECK( set_mtime(path, 1000000000) );
+    
+    NetgenNeutralMesh first;
+    CHECK( first.load(path) );
+    
+    std::string cache = mesh_cache_filename(path);
+    CHECK( truncate(cache.c_str(), sizeof(MeshCacheHeader) + 16) == 0 );
+    
+    test_file("truncated.mesh", moved_mesh);
+    CHECK( set_mtime(path, 1000000000) );
+    
+    NetgenNeutralMesh reloaded;
+    CHECK( reloaded.load(path) );
+    CHECK( reloaded.domains().zone(0).id() == 7 );
+}
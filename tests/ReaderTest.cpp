@@ -0,0 +1,223 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+
+#include "Mesh.h"
+#include "NetgenVolMesh.h"
+#include "GmshMesh.h"
+#include "Test.h"
+
+/* Elements must only index points in the file: numbers start from 1,
+ * 0 and anything past the point count are refused. */
+static bool
+load_text(NetgenNeutralMesh& mesh, const char *name, const std::string& text)
+{
+    mesh.setCacheEnabled(false);
+    return mesh.load( test_file(name, text) );
+}
+
+static const char tet_points[] =
+    "4\n"
+    "  0.0 0.0 0.0\n"
+    "  1.0 0.0 0.0\n"
+    "  0.0 1.0 0.0\n"
+    "  0.0 0.0 1.0\n";
+
+static std::string
+neutral_mesh(const char *tet, const char *tri)
+{
+    return std::string(tet_points) + "1\n" + tet + "\n1\n" + tri + "\n";
+}
+
+TEST(neutral_accepts_good_indices)
+{
+    NetgenNeutralMesh mesh;
+    CHECK( load_text(mesh, "good.mesh", neutral_mesh("1 1 2 3 4", "1 1 3 2")) );
+    CHECK( mesh.domains().size() == 1 && mesh.boundaries().size() == 1 );
+}
+
+TEST(neutral_rejects_bad_indices)
+{
+    NetgenNeutralMesh past, zero, tri;
+    CHECK( !load_text(past, "past.mesh", neutral_mesh("1 1 2 3 5", "1 1 3 2")) );
+    CHECK( !load_text(zero, "zero.mesh", neutral_mesh("1 0 2 3 4", "1 1 3 2")) );
+    CHECK( !load_text(tri, "tri.mesh", neutral_mesh("1 1 2 3 4", "1 1 3 9")) );
+}
+
+static std::string
+vol_mesh(const char *tet, const char *tri)
+{
+    return std::string("mesh3d\ndimension\n3\n"
+                       "surfaceelements\n1\n1 1 1 0 3 ") + tri + "\n"
+           "volumeelements\n1\n1 4 " + tet + "\n"
+           "points\n" + tet_points + "endmesh\n";
+}
+
+TEST(vol_accepts_good_indices)
+{
+    NetgenVolMesh mesh;
+    CHECK( load_text(mesh, "good.vol", vol_mesh("1 2 3 4", "1 3 2")) );
+    CHECK( mesh.domains().size() == 1 && mesh.boundaries().size() == 1 );
+}
+
+/* The elements come before the points, so they are checked at the end */
+TEST(vol_rejects_bad_indices)
+{
+    NetgenVolMesh past, zero, tri;
+    CHECK( !load_text(past, "past.vol", vol_mesh("1 2 3 5", "1 3 2")) );
+    CHECK( !load_text(zero, "zero.vol", vol_mesh("0 2 3 4", "1 3 2")) );
+    CHECK( !load_text(tri, "tri.vol", vol_mesh("1 2 3 4", "1 3 9")) );
+}
+
+template<typename T>
+static void
+append(std::string& out, T val)
+{
+    out.append((const char *)&val, sizeof(T));
+}
+
+/* Binary MSH 4.1 with the given node tags, at the corners of a
+ * tetrahedron, and a single tetrahedron */
+static std::string
+msh_mesh(const std::vector<uint64_t>& tags, const std::vector<uint64_t>& tet)
+{
+    std::string out = "$MeshFormat\n4.1 1 8\n";
+    append<int32_t>(out, 1);
+    out += "\n$EndMeshFormat\n$Nodes\n";
+    
+    append<uint64_t>(out, 1);
+    append<uint64_t>(out, tags.size());
+    append<uint64_t>(out, *std::min_element(tags.begin(), tags.end()));
+    append<uint64_t>(out, *std::max_element(tags.begin(), tags.end()));
+    append<int32_t>(out, 3);
+    append<int32_t>(out, 1);
+    append<int32_t>(out, 0);
+    append<uint64_t>(out, tags.size());
+    
+    for (auto t : tags)
+        append<uint64_t>(out, t);
+    
+    for (size_t i = 0; i < tags.size(); i++)
+        for (size_t d = 0; d < 3; d++)
+            append<double>(out, (i == d+1) ? 1.0 : 0.0);
+    
+    out += "\n$EndNodes\n$Elements\n";
+    
+    append<uint64_t>(out, 1);
+    append<uint64_t>(out, 1);
+    append<uint64_t>(out, 1);
+    append<uint64_t>(out, 1);
+    append<int32_t>(out, 3);
+    append<int32_t>(out, 1);
+    append<int32_t>(out, 4);
+    append<uint64_t>(out, 1);
+    append<uint64_t>(out, 1);
+    
+    for (auto t : tet)
+        append<uint64_t>(out, t);
+    
+    out += "\n$EndElements\n";
+    return out;
+}
+
+TEST(msh_accepts_good_indices)
+{
+    GmshMesh mesh;
+    CHECK( load_text(mesh, "good.msh", msh_mesh({1, 2, 3, 4}, {1, 2, 3, 4})) );
+    CHECK( mesh.domains().size() == 1 && mesh.points().size() == 4 );
+}
+
+/* Tags outside the node range, or in a gap of it */
+TEST(msh_rejects_bad_indices)
+{
+    GmshMesh past, below, gap;
+    CHECK( !load_text(past, "past.msh", msh_mesh({1, 2, 3, 4}, {1, 2, 3, 5})) );
+    CHECK( !load_text(below, "below.msh", msh_mesh({2, 3, 4, 5}, {1, 2, 3, 4})) );
+    CHECK( !load_text(gap, "gap.msh", msh_mesh({1, 2, 4, 5}, {1, 2, 3, 4})) );
+}
+
+/* Overwrites a value of a section header, offset bytes after the line
+ * that opens the section */
+template<typename T>
+static std::string
+patch(std::string msh, const char *section, size_t offset, T val)
+{
+    size_t pos = msh.find(section) + strlen(section) + offset;
+    msh.replace(pos, sizeof(T), (const char *)&val, sizeof(T));
+    return msh;
+}
+
+/* Counts and tag ranges of the file must not overflow what they are
+ * multiplied with, nor the tables sized from them */
+TEST(msh_rejects_bad_headers)
+{
+    const uint64_t huge = (uint64_t(1) << 61) + 1;
+    std::string good = msh_mesh({1, 2, 3, 4}, {1, 2, 3, 4});
+    std::vector<std::string> bad;
+    
+    /* Full tag range, reversed range, sparse range */
+    bad.push_back( patch(patch(good, "$Nodes\n", 16, uint64_t(0)),
+                         "$Nodes\n", 24, ~uint64_t(0)) );
+    bad.push_back( patch(good, "$Nodes\n", 16, uint64_t(5)) );
+    bad.push_back( patch(good, "$Nodes\n", 24, uint64_t(1) << 40) );
+    
+    /* Node and element blocks whose size wraps around */
+    bad.push_back( patch(good, "$Nodes\n", 44, huge) );
+    bad.push_back( patch(patch(good, "$Nodes\n", 8, huge),
+                         "$Nodes\n", 44, huge) );
+    bad.push_back( patch(good, "$Elements\n", 44, huge) );
+    
+    /* A surface with too many bounding curves */
+    std::string entities = "$Entities\n";
+    for (uint64_t n : { 0, 0, 1, 0 })
+        append<uint64_t>(entities, n);
+    append<int32_t>(entities, 1);
+    for (size_t i = 0; i < 6; i++)
+        append<double>(entities, 0.0);
+    append<uint64_t>(entities, 0);
+    append<uint64_t>(entities, huge);
+    entities += "\n$EndEntities\n";
+    
+    std::string with_entities = good;
+    with_entities.insert(with_entities.find("$Nodes\n"), entities);
+    bad.push_back(with_entities);
+    
+    for (size_t i = 0; i < bad.size(); i++)
+    {
+        GmshMesh mesh;
+        std::string name = "header" + std::to_string(i) + ".msh";
+        CHECK( !load_text(mesh, name.c_str(), bad[i]) );
+    }
+}
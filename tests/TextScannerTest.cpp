@@ -0,0 +1,175 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+
+#include "TextScanner.h"
+#include "Test.h"
+
+/* Hands out the text a few bytes at a time, like a decompressor */
+class PieceStream : public ByteStream
+{
+    std::string     _data, _buf;
+    size_t          _pos, _piece;
+    
+public:
+    PieceStream(const std::string& data, size_t piece)
+        : _data(data), _pos(0), _piece(piece)
+    {}
+    
+    bool
+    refill(const char *& cur, const char *& end)
+    {
+        if (_pos == _data.size())
+            return false;
+        
+        std::string buf(cur, end);
+        size_t n = std::min(_piece, _data.size() - _pos);
+        buf.append(_data, _pos, n);
+        _pos += n;
+        
+        _buf.swap(buf);
+        cur = _buf.data();
+        end = cur + _buf.size();
+        return true;
+    }
+};
+
+static const char *doubles[] = {
+    "0", "1.5", "-0.25", "+3", "1e10", "1E-5", "5.", ".5", "-0.0",
+    "0.1", "3.14159265358979323846", "123456789012345678901234",
+    "0.000000000000000000000000001", "1.7976931348623157e308",
+    "4.9e-324", "2.2250738585072014e-308", "9007199254740993",
+    "1e400", "-1e-400", "0.30000000000000004",
+    "0.1000000000000000055511151231257827021181583404541015625000000000001",
+    "1000000000000000000000000000000000000000000000000000000000000000000000e-70"
+};
+
+static std::string
+join_doubles(void)
+{
+    std::string text;
+    for (auto d : doubles)
+        text += std::string(d) + "\n";
+    return text;
+}
+
+static bool
+same_double(double a, double b)
+{
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+TEST(scanner_reads_sizes)
+{
+    const char text[] = "0 42\n+7\t18446744073709551615";
+    TextScanner scanner(text, text + sizeof(text) - 1);
+    size_t v;
+    
+    CHECK( scanner.read_size(v) && v == 0 );
+    CHECK( scanner.read_size(v) && v == 42 );
+    CHECK( scanner.read_size(v) && v == 7 );
+    CHECK( scanner.read_size(v) && v == SIZE_MAX );
+    CHECK( scanner.eof() );
+    CHECK( !scanner.read_size(v) );
+}
+
+TEST(scanner_rejects_bad_sizes)
+{
+    const char *bad[] = { "18446744073709551616", "-1", "x1", "+", "" };
+    
+    for (auto text : bad)
+    {
+        TextScanner scanner(text, text + strlen(text));
+        size_t v;
+        CHECK( !scanner.read_size(v) );
+    }
+}
+
+TEST(scanner_matches_strtod)
+{
+    for (auto text : doubles)
+    {
+        TextScanner scanner(text, text + strlen(text));
+        double v;
+        
+        CHECK( scanner.read_double(v) && same_double(v, strtod(text, nullptr)) );
+        CHECK( scanner.eof() );
+    }
+}
+
+TEST(scanner_stops_at_incomplete_exponent)
+{
+    const char text[] = "1e x";
+    TextScanner scanner(text, text + sizeof(text) - 1);
+    double v;
+    
+    CHECK( scanner.read_double(v) && v == 1.0 );
+    CHECK( scanner.peek() == 'e' );
+    CHECK( !scanner.read_double(v) );
+}
+
+TEST(scanner_words_and_lines)
+{
+    const char text[] = "points\n3 skipped words\n  endmesh";
+    TextScanner scanner(text, text + sizeof(text) - 1);
+    const char *word;
+    size_t len, v;
+    
+    CHECK( scanner.read_word(word, len) && std::string(word, len) == "points" );
+    CHECK( scanner.read_size(v) && v == 3 );
+    scanner.skip_line();
+    CHECK( scanner.read_word(word, len) && std::string(word, len) == "endmesh" );
+    CHECK( scanner.offset() == sizeof(text) - 1 );
+}
+
+/* Tokens cut by the refills must read as in a single range */
+TEST(scanner_reads_streams)
+{
+    std::string text = join_doubles();
+    
+    for (size_t piece : { size_t(1), size_t(3), size_t(4096) })
+    {
+        PieceStream stream(text, piece);
+        TextScanner scanner(stream);
+        
+        for (auto d : doubles)
+        {
+            double v;
+            CHECK( scanner.read_double(v) && same_double(v, strtod(d, nullptr)) );
+        }
+        
+        CHECK( scanner.eof() );
+        CHECK( scanner.offset() == text.size() );
+    }
+}
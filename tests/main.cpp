@@ -0,0 +1,96 @@
+/*
+ * This source file is part of EMT, the ElectroMagneticTool.
+ *
+ * Copyright (C) 2013, Matteo Cicuttin - matteo.cicuttin@uniud.it
+ * Department of Electrical Engineering, University of Udine
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the University of Udine nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY Matteo Cicuttin ``AS IS'' AND ANY
+ * EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL Matteo Cicuttin BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <vector>
+#include <utility>
+#include <fstream>
+#include <cstdlib>
+
+#include "Test.h"
+
+static std::vector< std::pair<const char *, TestFunction> >&
+test_cases(void)
+{
+    static std::vector< std::pair<const char *, TestFunction> > cases;
+    return cases;
+}
+
+static size_t failures = 0;
+
+TestCase::TestCase(const char *name, TestFunction func)
+{
+    test_cases().push_back( std::make_pair(name, func) );
+}
+
+bool
+test_check(bool ok, const char *cond, const char *file, int line)
+{
+    if (!ok)
+    {
+        std::cout << file << ":" << line << ": check failed: "
+                  << cond << std::endl;
+        failures++;
+    }
+    
+    return ok;
+}
+
+std::string
+test_file(const std::string& name, const std::string& contents)
+{
+    static std::string dir;
+    
+    if ( dir.empty() )
+    {
+        char tmpl[] = "/tmp/meshview_tests.XXXXXX";
+        if ( mkdtemp(tmpl) )
+            dir = tmpl;
+    }
+    
+    std::string path = dir + "/" + name;
+    std::ofstream ofs(path.c_str(), std::ofstream::binary);
+    ofs << contents;
+    return path;
+}
+
+int
+main(void)
+{
+    for (auto& tc : test_cases())
+    {
+        size_t before = failures;
+        tc.second();
+        std::cout << (failures == before ? "PASS " : "FAIL ")
+                  << tc.first << std::endl;
+    }
+    
+    std::cout << failures << " failed checks" << std::endl;
+    return failures ? 1 : 0;
+}
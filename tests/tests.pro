@@ -0,0 +1,25 @@
+# Unit tests of the mesh core: qmake && make && ./meshview_tests
+
+QT += core gui opengl
+
+CONFIG += console thread
+CONFIG -= app_bundle
+
+QMAKE_CXXFLAGS += -std=c++11
+
+LIBS += -lz
+
+TEMPLATE = app
+TARGET = meshview_tests
+DEPENDPATH += . ..
+INCLUDEPATH += . ..
+
+HEADERS += Test.h
+SOURCES += main.cpp TextScannerTest.cpp MeshCacheTest.cpp \
+           ReaderTest.cpp EdgesTest.cpp LodTest.cpp
+
+# Mesh core under test
+SOURCES += ../Mesh.cpp ../MappedFile.cpp ../MeshCache.cpp \
+           ../Decompressor.cpp ../PointStore.cpp ../Edges.cpp \
+           ../Topology.cpp ../NetgenVolMesh.cpp ../GmshMesh.cpp \
+           ../Lod.cpp